@@ -0,0 +1,60 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "ascii_converter.h"
+#include "ascii_frame.h"
+
+// Area-sampled 1080p RGB to a 160x60 grid with 1..N conversion threads,
+// N defaulting to the hardware thread count. Usage: thread_scaling_bench [N]
+int main(int argc, char** argv) {
+    const int width = 1920;
+    const int height = 1080;
+    const int columns = 160;
+    const int rows = 60;
+    const int frames = 200;
+    int max_threads = static_cast<int>(std::thread::hardware_concurrency());
+    if (argc > 1) {
+        max_threads = std::atoi(argv[1]);
+    }
+    max_threads = std::max(max_threads, 1);
+
+    std::vector<uint8_t> rgb(static_cast<size_t>(width) * height * 3);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            uint8_t* p = &rgb[(static_cast<size_t>(y) * width + x) * 3];
+            p[0] = static_cast<uint8_t>(x * 255 / width);
+            p[1] = static_cast<uint8_t>(y * 255 / height);
+            p[2] = static_cast<uint8_t>((x ^ y) & 0xff);
+        }
+    }
+    const VideoFrameView frame = VideoFrameView::packedRGB(rgb.data(), width, height);
+
+    std::printf("%dx%d -> %dx%d, area sampling, %s, %u hardware threads\n", width, height, columns, rows,
+                kernelIsaName(bestKernelIsa()), std::thread::hardware_concurrency());
+    std::printf("threads  ms/frame  speedup\n");
+    double single = 0;
+    for (int threads = 1; threads <= max_threads; threads++) {
+        AsciiConverter converter(columns, rows);
+        converter.setSamplingMode(SamplingMode::Area);
+        converter.setThreadCount(threads);
+        AsciiFrame out;
+        for (int i = 0; i < 10; i++) {
+            converter.convertInto(frame, out);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++) {
+            converter.convertInto(frame, out);
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        const double ms = elapsed.count() / frames;
+        if (threads == 1) {
+            single = ms;
+        }
+        std::printf("%7d  %8.3f  %7.2f\n", threads, ms, single / ms);
+    }
+    return 0;
+}
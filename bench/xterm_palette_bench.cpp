@@ -0,0 +1,84 @@
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include "ascii_frame.h"
+#include "ascii_kernels.h"
+#include "xterm_palette.h"
+
+// Accuracy of quantizeXterm256 against the exhaustive xterm256Nearest over
+// every 24-bit colour, then time per 160x60 frame of both on random and
+// smoothly varying colours.
+int main() {
+    const uint8_t* lut = xterm256Lut();
+    int undecided = 0;
+    for (int key = 0; key < 32 * 32 * 32; key++) {
+        undecided += lut[key] == 0;
+    }
+    std::printf("lookup table: %d of 32768 bins (%.1f%%) resolved per cell\n", undecided,
+                undecided * 100.0 / 32768);
+
+    ColorAsciiFrame all;
+    all.resize(256, 256);
+    AlignedBuffer indices;
+    long mismatches = 0;
+    for (int r = 0; r < 256; r++) {
+        for (int i = 0; i < 256 * 256; i++) {
+            all.red.data()[i] = static_cast<uint8_t>(r);
+            all.green.data()[i] = static_cast<uint8_t>(i >> 8);
+            all.blue.data()[i] = static_cast<uint8_t>(i);
+        }
+        quantizeXterm256(all, indices, bestKernelIsa());
+        for (int i = 0; i < 256 * 256; i++) {
+            mismatches += indices.data()[i] != xterm256Nearest(r, i >> 8, i & 0xff);
+        }
+    }
+    std::printf("mismatches against brute force: %ld of %d\n\n", mismatches, 1 << 24);
+
+    const int columns = 160;
+    const int rows = 60;
+    const int cells = columns * rows;
+    const int frames = 500;
+    ColorAsciiFrame random;
+    ColorAsciiFrame smooth;
+    random.resize(columns, rows);
+    smooth.resize(columns, rows);
+    std::mt19937 rng(1);
+    for (int i = 0; i < cells; i++) {
+        random.red.data()[i] = static_cast<uint8_t>(rng());
+        random.green.data()[i] = static_cast<uint8_t>(rng());
+        random.blue.data()[i] = static_cast<uint8_t>(rng());
+        smooth.red.data()[i] = static_cast<uint8_t>(i % columns * 255 / columns);
+        smooth.green.data()[i] = static_cast<uint8_t>(i / columns * 255 / rows);
+        smooth.blue.data()[i] = 128;
+    }
+
+    std::printf("%dx%d cells     us/frame (random)  us/frame (smooth)\n", columns, rows);
+    auto time = [&](auto&& quantize) {
+        double us[2];
+        const ColorAsciiFrame* inputs[2] = {&random, &smooth};
+        for (int f = 0; f < 2; f++) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; i++) {
+                quantize(*inputs[f]);
+            }
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            us[f] = elapsed.count() / frames;
+        }
+        std::printf("%18.1f %18.1f\n", us[0], us[1]);
+    };
+
+    std::printf("%-12s", "brute force");
+    time([&](const ColorAsciiFrame& frame) {
+        for (int i = 0; i < cells; i++) {
+            indices.data()[i] = xterm256Nearest(frame.red.data()[i], frame.green.data()[i], frame.blue.data()[i]);
+        }
+    });
+    for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::SSE41, KernelIsa::AVX2}) {
+        if (!kernelIsaSupported(isa)) {
+            continue;
+        }
+        std::printf("%-12s", kernelIsaName(isa));
+        time([&](const ColorAsciiFrame& frame) { quantizeXterm256(frame, indices, isa); });
+    }
+    return 0;
+}
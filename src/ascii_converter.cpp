@@ -1,96 +1,1434 @@
 #include "ascii_converter.h"
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <sstream>
+#include <thread>
+
+static inline uint8_t clampToByte(int value) {
+    return static_cast<uint8_t>(std::clamp(value, 0, 255));
+}
+
+static inline uint8_t expandLimitedLuma(int y) {
+    return clampToByte(((y - 16) * 255 + 109) / 219);
+}
+
+// One background autotuning run. It benchmarks a private converter on its
+// own copy of the frame, so it shares only the two flags with the converting
+// thread; best and pool are published by done.
+struct AsciiConverter::TuneJob {
+    std::string key;
+    std::string cache_path;
+    int output_width = 0;
+    int output_height = 0;
+    std::string ascii_chars;
+    SamplingMode sampling_mode = SamplingMode::Nearest;
+    GlyphMode glyph_mode = GlyphMode::Luma;
+    std::vector<uint8_t> pixels;
+    VideoFrameView frame;
+
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> done{false};
+    KernelChoice best{KernelIsa::Scalar, 1};
+    std::unique_ptr<ThreadPool> pool;    // best.threads - 1 workers
+    std::thread thread;
+};
+
+// BT.601 YUV to RGB in 8.8 fixed point.
+static inline void yuvToRgb(int y, int u, int v, bool limited_range, uint8_t* rgb) {
+    int d = u - 128;
+    int e = v - 128;
+    if (limited_range) {
+        int c = 298 * (y - 16) + 128;
+        rgb[0] = clampToByte((c + 409 * e) >> 8);
+        rgb[1] = clampToByte((c - 100 * d - 208 * e) >> 8);
+        rgb[2] = clampToByte((c + 516 * d) >> 8);
+    } else {
+        int c = 256 * y + 128;
+        rgb[0] = clampToByte((c + 359 * e) >> 8);
+        rgb[1] = clampToByte((c - 88 * d - 183 * e) >> 8);
+        rgb[2] = clampToByte((c + 454 * d) >> 8);
+    }
+}
 
 AsciiConverter::AsciiConverter(int output_width, int output_height)
-    : output_width_(output_width)
-    , output_height_(output_height)
-    , ascii_chars_(" .:-=+*#%@") {
+    : pending_snapshot_(nullptr)
+    , keyframe_requested_(false)
+    , published_threads_(1)
+    , output_width_(0)
+    , output_height_(0)
+    , sampling_mode_(SamplingMode::Nearest)
+    , glyph_mode_(GlyphMode::Luma)
+    , keyframe_pending_(true)
+    , kernel_isa_(KernelIsa::Scalar)
+    , luma_kernel_(nullptr)
+    , accumulate_kernel_(nullptr)
+    , sobel_kernel_(nullptr)
+    , threshold_kernel_(nullptr)
+    , dot_threshold_(128)
+    , auto_contrast_(false)
+    , contrast_smoothing_(0.1f)
+    , contrast_low_(0.0f)
+    , contrast_high_(255.0f)
+    , contrast_primed_(false)
+    , dithering_(false)
+    , dither_kernel_(nullptr)
+    , thread_count_(1)
+    , active_kernels_(KernelChoice{KernelIsa::Scalar, 1})
+    , autotune_(false)
+    , change_detection_(false)
+    , refresh_interval_(30)
+    , frames_since_refresh_(0)
+    , cells_valid_(false)
+    , cells_limited_range_(true)
+    , dirty_fraction_(1.0f)
+    , band_dirty_counts_(1)
+    , row_scratch_(1) {
+    for (int i = 0; i < 256; i++) {
+        tone_curve_[i] = static_cast<uint8_t>(i);
+    }
+    updateSettings([&](Settings& s) {
+        s.output_width = output_width;
+        s.output_height = output_height;
+    });
+    adoptSettings();
+}
+
+AsciiConverter::~AsciiConverter() {
+    for (auto& job : tune_jobs_) {
+        job->cancelled.store(true, std::memory_order_relaxed);
+    }
+    for (auto& job : tune_jobs_) {
+        job->thread.join();
+    }
+    delete pending_snapshot_.load(std::memory_order_acquire);
 }
 
 void AsciiConverter::setOutputSize(int width, int height) {
-    output_width_ = width;
-    output_height_ = height;
+    updateSettings([&](Settings& s) {
+        s.output_width = width;
+        s.output_height = height;
+    });
 }
 
 void AsciiConverter::setAsciiChars(const std::string& chars) {
-    ascii_chars_ = chars;
+    updateSettings([&](Settings& s) { s.ascii_chars = chars; });
 }
 
-uint8_t AsciiConverter::rgbToGray(uint8_t r, uint8_t g, uint8_t b) const {
-    return static_cast<uint8_t>(0.299 * r + 0.587 * g + 0.114 * b);
+void AsciiConverter::setSamplingMode(SamplingMode mode) {
+    updateSettings([&](Settings& s) { s.sampling_mode = mode; });
 }
 
-char AsciiConverter::grayToAscii(uint8_t gray) const {
-    int char_index = (gray * (ascii_chars_.length() - 1)) / 255;
-    char_index = std::clamp(char_index, 0, static_cast<int>(ascii_chars_.length() - 1));
-    return ascii_chars_[char_index];
+void AsciiConverter::setGlyphMode(GlyphMode mode) {
+    updateSettings([&](Settings& s) { s.glyph_mode = mode; });
 }
 
-std::string AsciiConverter::convertRGBBuffer(const uint8_t* rgb_buffer, int width, int height) {
-    std::string result;
-    result.reserve(output_height_ * (output_width_ + 1));
+void AsciiConverter::setDotThreshold(uint8_t threshold) {
+    updateSettings([&](Settings& s) { s.dot_threshold = threshold; });
+}
 
-    float scale_x = static_cast<float>(width) / output_width_;
-    float scale_y = static_cast<float>(height) / output_height_;
+void AsciiConverter::setAutoContrast(bool enabled, float smoothing) {
+    updateSettings([&](Settings& s) {
+        s.auto_contrast = enabled;
+        // Without any smoothing the percentiles would never leave the first frame's.
+        s.contrast_smoothing = std::clamp(smoothing, 0.01f, 1.0f);
+    });
+}
 
-    for (int y = 0; y < output_height_; y++) {
+void AsciiConverter::setDithering(bool enabled) {
+    updateSettings([&](Settings& s) { s.dithering = enabled; });
+}
+
+void AsciiConverter::setChangeDetection(bool enabled, int refresh_interval) {
+    updateSettings([&](Settings& s) {
+        s.change_detection = enabled;
+        s.refresh_interval = std::max(refresh_interval, 1);
+    });
+}
+
+bool AsciiConverter::setKernelIsa(KernelIsa isa) {
+    if (!lumaRowKernel(isa)) {
+        return false;
+    }
+    updateSettings([&](Settings& s) { s.kernel_isa = isa; });
+    return true;
+}
+
+void AsciiConverter::setThreadCount(int threads) {
+    updateSettings([&](Settings& s) { s.thread_count = std::max(threads, 1); });
+}
+
+void AsciiConverter::setAutotune(bool enabled, const std::string& cache_path) {
+    updateSettings([&](Settings& s) {
+        s.autotune = enabled;
+        s.autotune_cache = cache_path;
+    });
+}
+
+// Called with settings_mutex_ held. Replaces any snapshot the converting
+// thread has not picked up yet, so only the newest settings get applied.
+void AsciiConverter::publishSettings() {
+    std::unique_ptr<Snapshot> replaced(pending_snapshot_.exchange(nullptr, std::memory_order_acquire));
+    auto snapshot = std::make_unique<Snapshot>();
+    snapshot->settings = settings_;
+    buildTables(*snapshot);
+
+    const int threads = settings_.thread_count;
+    if (replaced && replaced->settings.thread_count == threads) {
+        snapshot->thread_pool = std::move(replaced->thread_pool);
+    } else if (threads > 1 && threads != published_threads_) {
+        // The calling thread takes a band too, so the pool needs one fewer worker.
+        snapshot->thread_pool = std::make_unique<ThreadPool>(threads - 1);
+    }
+    published_threads_ = threads;
+
+    VideoFrameView layout;
+    {
+        std::lock_guard<std::mutex> lock(layout_mutex_);
+        layout = frame_layout_;
+    }
+    if (layout.width > 0) {
+        snapshot->geometry = SamplingGeometry::acquire(layout, settings_.output_width, settings_.output_height);
+    }
+    pending_snapshot_.store(snapshot.release(), std::memory_order_release);
+}
+
+// Called by every conversion entry point before it reads any setting, so a
+// frame is converted with one consistent set of them. Cheap when nothing
+// changed: a single relaxed load.
+void AsciiConverter::adoptSettings() {
+    if (keyframe_requested_.load(std::memory_order_relaxed)) {
+        keyframe_requested_.store(false, std::memory_order_relaxed);
+        keyframe_pending_ = true;
+    }
+    if (!pending_snapshot_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::unique_ptr<Snapshot> snapshot(pending_snapshot_.exchange(nullptr, std::memory_order_acquire));
+    if (snapshot) {
+        applySnapshot(*snapshot);
+    }
+}
+
+void AsciiConverter::applySnapshot(Snapshot& snapshot) {
+    const Settings& s = snapshot.settings;
+    if (s.output_width != output_width_ || s.output_height != output_height_ || s.ascii_chars != ascii_chars_) {
+        keyframe_pending_ = true;
+        cells_valid_ = false;
+    }
+    if (s.sampling_mode != sampling_mode_ || s.glyph_mode != glyph_mode_ ||
+        s.change_detection != change_detection_ || s.refresh_interval != refresh_interval_) {
+        cells_valid_ = false;
+    }
+    if (s.change_detection != change_detection_) {
+        dirty_fraction_ = 1.0f;
+    }
+    if (s.auto_contrast != auto_contrast_ || s.contrast_smoothing != contrast_smoothing_) {
+        contrast_primed_ = false;
+        for (int i = 0; i < 256; i++) {
+            tone_curve_[i] = static_cast<uint8_t>(i);
+        }
+    }
+
+    if (s.autotune != autotune_ || s.sampling_mode != sampling_mode_ || s.glyph_mode != glyph_mode_ ||
+        s.autotune_cache != tune_cache_path_) {
+        tuned_key_.clear();
+    }
+    autotune_ = s.autotune;
+    tune_cache_path_ = s.autotune_cache;
+
+    output_width_ = s.output_width;
+    output_height_ = s.output_height;
+    ascii_chars_ = s.ascii_chars;
+    sampling_mode_ = s.sampling_mode;
+    glyph_mode_ = s.glyph_mode;
+    glyph_tables_ = snapshot.glyph_tables;
+    index_tables_ = snapshot.index_tables;
+    gray_tables_ = snapshot.gray_tables;
+    shape_masks_.swap(snapshot.shape_masks);
+    dot_threshold_ = s.dot_threshold;
+    auto_contrast_ = s.auto_contrast;
+    contrast_smoothing_ = s.contrast_smoothing;
+    dithering_ = s.dithering;
+    change_detection_ = s.change_detection;
+    refresh_interval_ = s.refresh_interval;
+
+    // A tuned choice stands until the geometry changes.
+    if (!autotune_ || tuned_key_.empty()) {
+        useKernels(s.kernel_isa, s.thread_count, std::move(snapshot.thread_pool));
+    }
+    prepared_geometry_ = std::move(snapshot.geometry);
+}
+
+// pool, when given, must have threads - 1 workers.
+void AsciiConverter::useKernels(KernelIsa isa, int threads, std::unique_ptr<ThreadPool> pool) {
+    kernel_isa_ = isa;
+    luma_kernel_ = lumaRowKernel(kernel_isa_);
+    accumulate_kernel_ = accumulateRowKernel(kernel_isa_);
+    sobel_kernel_ = sobelRowKernel(kernel_isa_);
+    threshold_kernel_ = thresholdBitsKernel(kernel_isa_);
+    dither_kernel_ = ditherRowKernel(kernel_isa_);
+
+    if (threads != thread_count_) {
+        thread_count_ = threads;
+        if (!pool && thread_count_ > 1) {
+            pool = std::make_unique<ThreadPool>(thread_count_ - 1);
+        }
+        thread_pool_ = std::move(pool);
+        row_scratch_.resize(thread_count_);
+        band_dirty_counts_.resize(thread_count_);
+    }
+    active_kernels_.store({kernel_isa_, thread_count_}, std::memory_order_relaxed);
+}
+
+// Starts a background run for the current geometry, reading the pixels from
+// a copy since the caller may reuse its buffer as soon as this frame is done.
+// The tuned choice stays in converter state only, so applySnapshot keeps it
+// until the geometry changes and getActiveKernels reports it.
+void AsciiConverter::autotuneFor(const VideoFrameView& frame) {
+    std::ostringstream key;
+    key << static_cast<int>(frame.format) << ':' << frame.width << 'x' << frame.height << ':'
+        << output_width_ << 'x' << output_height_ << ':' << static_cast<int>(sampling_mode_) << ':'
+        << static_cast<int>(glyph_mode_);
+    tuned_key_ = key.str();
+
+    auto job = std::make_unique<TuneJob>();
+    job->key = tuned_key_;
+    job->cache_path = tune_cache_path_;
+    job->output_width = output_width_;
+    job->output_height = output_height_;
+    job->ascii_chars = ascii_chars_;
+    job->sampling_mode = sampling_mode_;
+    job->glyph_mode = glyph_mode_;
+
+    const int planes = frame.format == PixelFormat::I420 ? 3 : frame.format == PixelFormat::NV12 ? 2 : 1;
+    const int chroma_width = (frame.width + 1) / 2;
+    const int rows[3] = {frame.height, (frame.height + 1) / 2, (frame.height + 1) / 2};
+    const int row_bytes[3] = {frame.width * pixelStride(frame.format),
+                              frame.format == PixelFormat::NV12 ? chroma_width * 2 : chroma_width, chroma_width};
+    size_t offsets[3] = {0, 0, 0};
+    size_t total = 0;
+    for (int p = 0; p < planes; p++) {
+        offsets[p] = total;
+        total += static_cast<size_t>(frame.strides[p]) * rows[p];
+    }
+    job->pixels.resize(total);
+    job->frame = frame;
+    for (int p = 0; p < planes; p++) {
+        if (rows[p] > 0) {
+            memcpy(job->pixels.data() + offsets[p], frame.planes[p],
+                   static_cast<size_t>(frame.strides[p]) * (rows[p] - 1) + row_bytes[p]);
+        }
+        job->frame.planes[p] = job->pixels.data() + offsets[p];
+    }
+
+    TuneJob* running = job.get();
+    job->thread = std::thread([running]() { runTuneJob(*running); });
+    tune_jobs_.push_back(std::move(job));
+}
+
+// Adopts the result of the run for the current geometry once it is done,
+// cancels runs for anything else and joins the runs that have stopped.
+void AsciiConverter::collectTuneJobs() {
+    for (auto it = tune_jobs_.begin(); it != tune_jobs_.end();) {
+        TuneJob& job = **it;
+        const bool current = autotune_ && job.key == tuned_key_;
+        if (!current) {
+            job.cancelled.store(true, std::memory_order_relaxed);
+        }
+        if (!job.done.load(std::memory_order_acquire)) {
+            ++it;
+            continue;
+        }
+        job.thread.join();
+        if (current && !job.cancelled.load(std::memory_order_relaxed)) {
+            useKernels(job.best.isa, job.best.threads, std::move(job.pool));
+        }
+        it = tune_jobs_.erase(it);
+    }
+}
+
+// Looks the geometry up in the cache, or times a few text conversions of
+// the frame with each candidate on a private converter and records the
+// fastest. Also builds the pool for the choice, so adopting it is a swap.
+void AsciiConverter::runTuneJob(TuneJob& job) {
+    KernelTuneCache cache(job.cache_path);
+    KernelChoice best{KernelIsa::Scalar, 1};
+    if (!cache.lookup(job.key, best)) {
+        std::vector<int> thread_counts{1};
+        const int hardware_threads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+        for (int threads = 2; threads < hardware_threads; threads *= 2) {
+            thread_counts.push_back(threads);
+        }
+        if (hardware_threads > 1) {
+            thread_counts.push_back(hardware_threads);
+        }
+
+        AsciiConverter converter(job.output_width, job.output_height);
+        converter.setAsciiChars(job.ascii_chars);
+        converter.setSamplingMode(job.sampling_mode);
+        converter.setGlyphMode(job.glyph_mode);
+        AsciiFrame out;
+        double best_time = std::numeric_limits<double>::infinity();
+        for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::SSE41, KernelIsa::AVX2}) {
+            if (!kernelIsaSupported(isa)) {
+                continue;
+            }
+            for (int threads : thread_counts) {
+                if (job.cancelled.load(std::memory_order_relaxed)) {
+                    job.done.store(true, std::memory_order_release);
+                    return;
+                }
+                converter.setKernelIsa(isa);
+                converter.setThreadCount(threads);
+                converter.convertInto(job.frame, out);    // warm-up, adopts the kernels
+                double time = std::numeric_limits<double>::infinity();
+                for (int run = 0; run < 3; run++) {
+                    auto start = std::chrono::steady_clock::now();
+                    converter.convertInto(job.frame, out);
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                    time = std::min(time, elapsed.count());
+                }
+                if (time < best_time) {
+                    best_time = time;
+                    best = {isa, threads};
+                }
+            }
+        }
+        cache.store(job.key, best);
+    }
+
+    job.best = best;
+    if (best.threads > 1) {
+        job.pool = std::make_unique<ThreadPool>(best.threads - 1);
+    }
+    job.done.store(true, std::memory_order_release);
+}
+
+void AsciiConverter::buildTables(Snapshot& snapshot) {
+    const std::string& ascii_chars = snapshot.settings.ascii_chars;
+    OutputTables& glyph_tables = snapshot.glyph_tables;
+    OutputTables& index_tables = snapshot.index_tables;
+    OutputTables& gray_tables = snapshot.gray_tables;
+
+    // The index "palette" is just 0..n-1, so the same kernels emit indices.
+    std::string indices(std::min<size_t>(ascii_chars.size(), 256), '\0');
+    for (size_t i = 0; i < indices.size(); i++) {
+        indices[i] = static_cast<char>(i);
+    }
+    buildGlyphTable(glyph_tables.full_range, ascii_chars);
+    buildGlyphTable(index_tables.full_range, indices);
+    glyph_tables.blank = ' ';
+    index_tables.blank = 0;
+
+    for (int y = 0; y < 256; y++) {
+        uint8_t full = expandLimitedLuma(y);
+        glyph_tables.limited_range[y] = glyph_tables.full_range.lut[full];
+        index_tables.limited_range[y] = index_tables.full_range.lut[full];
+    }
+    const char edge_glyphs[4] = {'|', '/', '-', '\\'};
+    for (int i = 0; i < 4; i++) {
+        size_t position = ascii_chars.find(edge_glyphs[i]);
+        glyph_tables.edges[i] = edge_glyphs[i];
+        index_tables.edges[i] = position < indices.size() ? static_cast<int>(position) : -1;
+        gray_tables.edges[i] = -1;
+    }
+
+    gray_tables.full_range.palette_size = 256;
+    memset(gray_tables.full_range.palette, 0, sizeof(gray_tables.full_range.palette));
+    gray_tables.blank = 0;
+    snapshot.shape_masks.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        snapshot.shape_masks[i] = glyphMask(ascii_chars[i]);
+    }
+    for (int i = 0; i < 256; i++) {
+        gray_tables.full_range.lut[i] = static_cast<char>(i);
+        gray_tables.limited_range[i] = static_cast<char>(expandLimitedLuma(i));
+        gray_tables.by_index[i] = static_cast<char>(i);
+        glyph_tables.by_index[i] = i < static_cast<int>(ascii_chars.size()) ? ascii_chars[i] : ' ';
+        index_tables.by_index[i] = static_cast<char>(i);
+    }
+    if (indices.empty()) {
+        memset(index_tables.full_range.lut, 0, sizeof(index_tables.full_range.lut));
+        memset(index_tables.limited_range, 0, sizeof(index_tables.limited_range));
+    }
+}
+
+const SamplingGeometry& AsciiConverter::geometryFor(const VideoFrameView& frame) {
+    if (!geometry_ || !geometry_->matches(frame, output_width_, output_height_)) {
+        if (prepared_geometry_ && prepared_geometry_->matches(frame, output_width_, output_height_)) {
+            geometry_ = std::move(prepared_geometry_);
+        } else {
+            geometry_ = SamplingGeometry::acquire(frame, output_width_, output_height_);
+            std::lock_guard<std::mutex> lock(layout_mutex_);
+            frame_layout_ = frame;
+            std::fill(std::begin(frame_layout_.planes), std::end(frame_layout_.planes), nullptr);
+        }
+        prepared_geometry_.reset();
+        cells_valid_ = false;
+        tuned_key_.clear();
+    }
+    if (!tune_jobs_.empty()) {
+        collectTuneJobs();
+    }
+    if (autotune_ && tuned_key_.empty()) {
+        autotuneFor(frame);
+    }
+    return *geometry_;
+}
+
+// Averages every pixel of a plane under each cell of one output row into out,
+// channels bytes per cell. Source rows are summed column-wise with the
+// accumulate kernel, then each cell's columns are reduced; 16-bit sums are
+// flushed every 257 rows.
+void AsciiConverter::averagePlaneRow(const uint8_t* plane, int stride, int plane_width, int channels,
+                                     const int* col_begin, const int* col_end, int row_begin, int row_end,
+                                     RowScratch& scratch, std::vector<uint8_t>& out) {
+    const int max_rows_per_flush = 257;
+    const int row_bytes = plane_width * channels;
+
+    scratch.row_sums.assign(row_bytes, 0);
+    scratch.cell_sums.assign(output_width_ * channels, 0);
+    out.resize(output_width_ * channels);
+
+    auto flush = [&]() {
         for (int x = 0; x < output_width_; x++) {
-            int src_x = static_cast<int>(x * scale_x);
-            int src_y = static_cast<int>(y * scale_y);
+            uint32_t* sums = &scratch.cell_sums[x * channels];
+            for (int i = col_begin[x] * channels; i < col_end[x] * channels; i += channels) {
+                for (int c = 0; c < channels; c++) {
+                    sums[c] += scratch.row_sums[i + c];
+                }
+            }
+        }
+        std::fill(scratch.row_sums.begin(), scratch.row_sums.end(), 0);
+    };
 
-            if (src_x < width && src_y < height) {
-                int pixel_index = (src_y * width + src_x) * 3;
+    int pending = 0;
+    for (int src_y = row_begin; src_y < row_end; src_y++) {
+        accumulate_kernel_(plane + static_cast<size_t>(src_y) * stride, scratch.row_sums.data(), row_bytes);
+        if (++pending == max_rows_per_flush) {
+            flush();
+            pending = 0;
+        }
+    }
+    if (pending > 0) {
+        flush();
+    }
 
-                uint8_t r = rgb_buffer[pixel_index];
-                uint8_t g = rgb_buffer[pixel_index + 1];
-                uint8_t b = rgb_buffer[pixel_index + 2];
+    for (int x = 0; x < output_width_; x++) {
+        uint32_t count = static_cast<uint32_t>((col_end[x] - col_begin[x]) * (row_end - row_begin));
+        for (int c = 0; c < channels; c++) {
+            out[x * channels + c] = static_cast<uint8_t>((scratch.cell_sums[x * channels + c] + count / 2) / count);
+        }
+    }
+}
+
+// Fills scratch.cell_rgb with the colour and scratch.cell_luma with the
+// full-range luma sampled for each cell of output row y, and returns how many
+// leading cells are inside the frame.
+int AsciiConverter::sampleRowColor(const VideoFrameView& frame, const SamplingGeometry& geometry, int y,
+                                   RowScratch& scratch) {
+    const int bytes_per_pixel = pixelStride(frame.format);
+    const int r = isBlueFirst(frame.format) ? 2 : 0;
+    const int b = 2 - r;
+    const bool expand_luma = isYUV(frame.format) && frame.limited_range;
+    scratch.cell_rgb.resize(output_width_ * 3);
+    scratch.cell_luma.resize(output_width_);
+    uint8_t* rgb = scratch.cell_rgb.data();
+    uint8_t* luma = scratch.cell_luma.data();
 
-                uint8_t gray = rgbToGray(r, g, b);
-                char ascii_char = grayToAscii(gray);
+    if (sampling_mode_ == SamplingMode::Area) {
+        averagePlaneRow(frame.planes[0], frame.strides[0], frame.width, bytes_per_pixel,
+                        geometry.col_bounds.data(), geometry.col_end.data(),
+                        geometry.row_bounds[y], geometry.row_end[y], scratch, scratch.plane_avg);
+        const uint8_t* avg = scratch.plane_avg.data();
 
-                result += ascii_char;
+        if (isYUV(frame.format)) {
+            const int chroma_width = (frame.width + 1) / 2;
+            const int* col_begin = geometry.chroma_col_bounds.data();
+            const int* col_end = geometry.chroma_col_end.data();
+            int row_begin = geometry.chroma_row_bounds[y];
+            int row_end = geometry.chroma_row_end[y];
+            if (frame.format == PixelFormat::NV12) {
+                averagePlaneRow(frame.planes[1], frame.strides[1], chroma_width, 2, col_begin, col_end,
+                                row_begin, row_end, scratch, scratch.chroma_avg[0]);
             } else {
-                result += ' ';
+                averagePlaneRow(frame.planes[1], frame.strides[1], chroma_width, 1, col_begin, col_end,
+                                row_begin, row_end, scratch, scratch.chroma_avg[0]);
+                averagePlaneRow(frame.planes[2], frame.strides[2], chroma_width, 1, col_begin, col_end,
+                                row_begin, row_end, scratch, scratch.chroma_avg[1]);
             }
         }
-        result += '\n';
+
+        for (int x = 0; x < output_width_; x++) {
+            uint8_t* cell = rgb + x * 3;
+            if (isPackedRGB(frame.format)) {
+                const uint8_t* p = avg + x * bytes_per_pixel;
+                cell[0] = p[r];
+                cell[1] = p[1];
+                cell[2] = p[b];
+                luma[x] = lumaFixed(cell[0], cell[1], cell[2]);
+                continue;
+            }
+            if (frame.format == PixelFormat::NV12) {
+                yuvToRgb(avg[x], scratch.chroma_avg[0][x * 2], scratch.chroma_avg[0][x * 2 + 1],
+                         frame.limited_range, cell);
+            } else if (frame.format == PixelFormat::I420) {
+                yuvToRgb(avg[x], scratch.chroma_avg[0][x], scratch.chroma_avg[1][x], frame.limited_range, cell);
+            } else {
+                cell[0] = cell[1] = cell[2] = avg[x];
+            }
+            luma[x] = expand_luma ? expandLimitedLuma(avg[x]) : avg[x];
+        }
+        return output_width_;
+    }
+
+    if (geometry.row_offsets[y] < 0) {
+        return 0;
+    }
+
+    const uint8_t* src_row = frame.planes[0] + geometry.row_offsets[y];
+    for (int x = 0; x < geometry.valid_cols; x++) {
+        const uint8_t* p = src_row + geometry.col_offsets[x];
+        uint8_t* cell = rgb + x * 3;
+        if (isPackedRGB(frame.format)) {
+            cell[0] = p[r];
+            cell[1] = p[1];
+            cell[2] = p[b];
+            luma[x] = lumaFixed(cell[0], cell[1], cell[2]);
+            continue;
+        }
+        if (isYUV(frame.format)) {
+            const ptrdiff_t chroma = geometry.chroma_row_offsets[y] + geometry.chroma_col_offsets[x];
+            const uint8_t* u = frame.planes[1] + chroma;
+            const uint8_t* v = frame.format == PixelFormat::NV12
+                                   ? u + 1
+                                   : frame.planes[2] + geometry.v_row_offsets[y] + geometry.chroma_col_offsets[x];
+            yuvToRgb(p[0], *u, *v, frame.limited_range, cell);
+        } else {
+            cell[0] = cell[1] = cell[2] = p[0];
+        }
+        luma[x] = expand_luma ? expandLimitedLuma(p[0]) : p[0];
     }
+    return geometry.valid_cols;
+}
 
+std::string AsciiConverter::convertRGBBuffer(const uint8_t* rgb_buffer, int width, int height) {
+    adoptSettings();
+    std::string result(output_height_ * (output_width_ + 1), ' ');
+    writeLines(VideoFrameView::packedRGB(rgb_buffer, width, height), glyph_tables_, &result[0], output_width_ + 1);
     return result;
 }
 
 AsciiLayers AsciiConverter::convertRGBBufferToLayers(const uint8_t* rgb_buffer, int width, int height) {
+    adoptSettings();
+    const size_t size = output_height_ * (output_width_ + 1);
     AsciiLayers layers;
-    layers.red_layer = convertSingleChannel(rgb_buffer, width, height, 0);    // Red channel
-    layers.green_layer = convertSingleChannel(rgb_buffer, width, height, 1);  // Green channel
-    layers.blue_layer = convertSingleChannel(rgb_buffer, width, height, 2);   // Blue channel
+    layers.red_layer.resize(size);
+    layers.green_layer.resize(size);
+    layers.blue_layer.resize(size);
+    convertLayerLines(VideoFrameView::packedRGB(rgb_buffer, width, height),
+                      &layers.red_layer[0], &layers.green_layer[0], &layers.blue_layer[0]);
     return layers;
 }
 
-std::string AsciiConverter::convertSingleChannel(const uint8_t* rgb_buffer, int width, int height, int channel) {
-    std::string result;
-    result.reserve(output_height_ * (output_width_ + 1));
+void AsciiConverter::convertInto(const uint8_t* rgb_buffer, int width, int height, AsciiFrame& frame) {
+    convertInto(VideoFrameView::packedRGB(rgb_buffer, width, height), frame);
+}
+
+void AsciiConverter::convertLayersInto(const uint8_t* rgb_buffer, int width, int height, AsciiLayerFrames& layers) {
+    convertLayersInto(VideoFrameView::packedRGB(rgb_buffer, width, height), layers);
+}
+
+void AsciiConverter::convertInto(const VideoFrameView& frame, AsciiFrame& out) {
+    adoptSettings();
+    out.resize(output_width_, output_height_);
+    writeLines(frame, glyph_tables_, out.line(0), output_width_ + 1);
+}
+
+void AsciiConverter::convertLayersInto(const VideoFrameView& frame, AsciiLayerFrames& layers) {
+    adoptSettings();
+    layers.red.resize(output_width_, output_height_);
+    layers.green.resize(output_width_, output_height_);
+    layers.blue.resize(output_width_, output_height_);
+    convertLayerLines(frame, layers.red.line(0), layers.green.line(0), layers.blue.line(0));
+}
+
+void AsciiConverter::convertIndicesInto(const VideoFrameView& frame, GlyphIndexFrame& out) {
+    adoptSettings();
+    const int bits = ascii_chars_.size() <= 16 ? 4 : 8;
+    out.resize(output_width_, output_height_, bits);
+    if (bits == 8) {
+        writeLines(frame, index_tables_, reinterpret_cast<char*>(out.indices.data()), out.row_bytes);
+        return;
+    }
+
+    index_scratch_.resize(static_cast<size_t>(output_width_) * output_height_);
+    writeLines(frame, index_tables_, reinterpret_cast<char*>(index_scratch_.data()), output_width_);
+    for (int y = 0; y < output_height_; y++) {
+        packNibbles(index_scratch_.data() + static_cast<size_t>(y) * output_width_, output_width_, out.row(y));
+    }
+}
+
+void AsciiConverter::convertIndicesInto(const VideoFrameView& frame, GlyphIndexFrame& out, GlyphDelta& delta) {
+    convertIndicesInto(frame, out);
+    diffGlyphIndices(previous_indices_, out, delta, kernel_isa_);
+    if (keyframe_pending_) {
+        delta.keyframe = true;
+        delta.runs.clear();
+        keyframe_pending_ = false;
+    }
+
+    previous_indices_.resize(out.width, out.height, out.bits);
+    memcpy(previous_indices_.indices.data(), out.indices.data(), out.indices.size());
+}
+
+void AsciiConverter::convertUtf8Into(const VideoFrameView& frame, Utf8Mode mode, Utf8Frame& out) {
+    adoptSettings();
+    // Every glyph of both modes encodes to three bytes, except the space.
+    const int max_bytes_per_cell = 3;
+    const size_t line_capacity = static_cast<size_t>(output_width_) * max_bytes_per_cell + 1;
+    out.reserve(output_width_, output_height_, max_bytes_per_cell);
+    const SamplingGeometry& geometry = geometryFor(frame);
+    char* text = reinterpret_cast<char*>(out.text.data());
+
+    // Luma-plane samples are compared in their own range.
+    uint8_t threshold = dot_threshold_;
+    if (isYUV(frame.format) && frame.limited_range) {
+        threshold = static_cast<uint8_t>(16 + (threshold * 219 + 127) / 255);
+    }
+
+    line_lengths_.resize(output_height_);
+    forEachRowBand([&](int first_row, int end_row, int band) {
+        for (int y = first_row; y < end_row; y++) {
+            line_lengths_[y] = convertUtf8Row(frame, geometry, y, mode, threshold, row_scratch_[band],
+                                              text + y * line_capacity);
+        }
+    });
+
+    // Rows were written at worst-case offsets; close the gaps.
+    size_t size = 0;
+    for (int y = 0; y < output_height_; y++) {
+        memmove(text + size, text + y * line_capacity, line_lengths_[y]);
+        size += line_lengths_[y];
+    }
+    out.text.resize(size);
+}
+
+bool AsciiConverter::convertPyramidInto(const VideoFrameView& frame, const std::vector<GridSize>& sizes,
+                                        std::vector<AsciiFrame>& levels) {
+    adoptSettings();
+    for (const GridSize& size : sizes) {
+        if (size.width > output_width_ || size.height > output_height_) {
+            return false;
+        }
+    }
+    cell_gray_.resize(static_cast<size_t>(output_width_) * output_height_);
+    convertLines(frame, gray_tables_, GlyphMode::Luma, reinterpret_cast<char*>(cell_gray_.data()), output_width_);
+
+    levels.resize(sizes.size());
+    for (size_t i = 0; i < sizes.size(); i++) {
+        downsampleCells(cell_gray_.data(), sizes[i], levels[i]);
+    }
+    return true;
+}
+
+// Level cell x covers grid columns [pyramid_cols_[2x], pyramid_cols_[2x + 1]),
+// and likewise for rows; size never exceeds the grid.
+void AsciiConverter::downsampleCells(const uint8_t* gray, GridSize size, AsciiFrame& out) {
+    if (size.width <= 0 || size.height <= 0) {
+        out.resize(0, 0);
+        return;
+    }
+    const int width = size.width;
+    const int height = size.height;
+    out.resize(width, height);
+    const char* lut = glyph_tables_.full_range.lut;
+
+    if (width == output_width_ && height == output_height_) {
+        for (int y = 0; y < height; y++) {
+            char* line = out.line(y);
+            const uint8_t* src = gray + static_cast<size_t>(y) * output_width_;
+            for (int x = 0; x < width; x++) {
+                line[x] = lut[src[x]];
+            }
+            line[width] = '\n';
+        }
+        return;
+    }
+
+    auto bounds = [](int i, int count, int extent, int* range) {
+        range[0] = std::min(static_cast<int>(static_cast<int64_t>(i) * extent / count), extent - 1);
+        range[1] = std::max(static_cast<int>(static_cast<int64_t>(i + 1) * extent / count), range[0] + 1);
+    };
+    pyramid_cols_.resize(2 * width);
+    for (int x = 0; x < width; x++) {
+        bounds(x, width, output_width_, &pyramid_cols_[2 * x]);
+    }
+    pyramid_sums_.resize(width);
+
+    for (int y = 0; y < height; y++) {
+        int rows[2];
+        bounds(y, height, output_height_, rows);
+        std::fill(pyramid_sums_.begin(), pyramid_sums_.end(), 0u);
+        for (int row = rows[0]; row < rows[1]; row++) {
+            const uint8_t* src = gray + static_cast<size_t>(row) * output_width_;
+            for (int x = 0; x < width; x++) {
+                uint32_t sum = 0;
+                for (int col = pyramid_cols_[2 * x]; col < pyramid_cols_[2 * x + 1]; col++) {
+                    sum += src[col];
+                }
+                pyramid_sums_[x] += sum;
+            }
+        }
+
+        char* line = out.line(y);
+        for (int x = 0; x < width; x++) {
+            const uint32_t area = static_cast<uint32_t>(pyramid_cols_[2 * x + 1] - pyramid_cols_[2 * x]) *
+                                  (rows[1] - rows[0]);
+            line[x] = lut[(pyramid_sums_[x] + area / 2) / area];
+        }
+        line[width] = '\n';
+    }
+}
+
+void AsciiConverter::convertColorInto(const VideoFrameView& frame, ColorAsciiFrame& out) {
+    adoptSettings();
+    out.resize(output_width_, output_height_);
+    const SamplingGeometry& geometry = geometryFor(frame);
+    const char* index_lut = index_tables_.full_range.lut;
+
+    forEachRowBand([&](int first_row, int end_row, int band) {
+        for (int y = first_row; y < end_row; y++) {
+            uint8_t* glyphs = out.glyphs.data() + static_cast<size_t>(y) * output_width_;
+            uint8_t* red = out.red.data() + static_cast<size_t>(y) * output_width_;
+            uint8_t* green = out.green.data() + static_cast<size_t>(y) * output_width_;
+            uint8_t* blue = out.blue.data() + static_cast<size_t>(y) * output_width_;
+
+            RowScratch& scratch = row_scratch_[band];
+            int valid_cols = sampleRowColor(frame, geometry, y, scratch);
+            const uint8_t* rgb = scratch.cell_rgb.data();
+            const uint8_t* luma = scratch.cell_luma.data();
+            for (int x = 0; x < valid_cols; x++) {
+                glyphs[x] = static_cast<uint8_t>(index_lut[luma[x]]);
+                red[x] = rgb[x * 3];
+                green[x] = rgb[x * 3 + 1];
+                blue[x] = rgb[x * 3 + 2];
+            }
+            for (int x = valid_cols; x < output_width_; x++) {
+                glyphs[x] = red[x] = green[x] = blue[x] = 0;
+            }
+        }
+    });
+}
 
-    float scale_x = static_cast<float>(width) / output_width_;
-    float scale_y = static_cast<float>(height) / output_height_;
+// Writes one output row per line_stride bytes of out. Lines longer than the
+// grid width (text) get a trailing newline.
+void AsciiConverter::writeLines(const VideoFrameView& frame, const OutputTables& tables,
+                                char* out, size_t line_stride) {
+    if ((auto_contrast_ || dithering_) && glyph_mode_ == GlyphMode::Luma) {
+        dirty_fraction_ = 1.0f;
+        convertToned(frame, tables, out, line_stride);
+        return;
+    }
+    // Cell indices are bytes, so larger palettes cannot be tracked; nearest
+    // sampling reads no more pixels than the signatures would.
+    if (!change_detection_ || glyph_mode_ != GlyphMode::Luma || sampling_mode_ != SamplingMode::Area ||
+        ascii_chars_.size() > 256) {
+        dirty_fraction_ = 1.0f;
+        convertLines(frame, tables, glyph_mode_, out, line_stride);
+        return;
+    }
 
+    updateChangedCells(frame);
+    const bool newline = line_stride > static_cast<size_t>(output_width_);
     for (int y = 0; y < output_height_; y++) {
+        char* line = out + y * line_stride;
+        const uint8_t* indices = cell_indices_.data() + static_cast<size_t>(y) * output_width_;
         for (int x = 0; x < output_width_; x++) {
-            int src_x = static_cast<int>(x * scale_x);
-            int src_y = static_cast<int>(y * scale_y);
-
-            if (src_x < width && src_y < height) {
-                int pixel_index = (src_y * width + src_x) * 3;
-                uint8_t channel_value = rgb_buffer[pixel_index + channel];
-                char ascii_char = grayToAscii(channel_value);
-                result += ascii_char;
+            line[x] = tables.by_index[indices[x]];
+        }
+        if (newline) {
+            line[output_width_] = '\n';
+        }
+    }
+}
+
+// Converts cells to full-range gray levels with the regular row kernels,
+// then applies auto-contrast (histogram, tone curve) and/or ordered
+// dithering before writing glyphs.
+void AsciiConverter::convertToned(const VideoFrameView& frame, const OutputTables& tables,
+                                  char* out, size_t line_stride) {
+    const size_t cells = static_cast<size_t>(output_width_) * output_height_;
+    cell_gray_.resize(cells);
+    convertLines(frame, gray_tables_, GlyphMode::Luma, reinterpret_cast<char*>(cell_gray_.data()), output_width_);
+    const SamplingGeometry& geometry = *geometry_;
+
+    // Cells outside the frame are blank, not black.
+    auto validCols = [&](int y) {
+        if (sampling_mode_ == SamplingMode::Area) {
+            return output_width_;
+        }
+        return geometry.row_offsets[y] < 0 ? 0 : geometry.valid_cols;
+    };
+
+    if (auto_contrast_) {
+        forEachRowBand([&](int first_row, int end_row, int band) {
+            // Four banks so runs of equal values do not serialise on one counter.
+            uint32_t* banks = row_scratch_[band].histogram;
+            memset(banks, 0, sizeof(row_scratch_[band].histogram));
+            for (int y = first_row; y < end_row; y++) {
+                const uint8_t* gray = cell_gray_.data() + static_cast<size_t>(y) * output_width_;
+                const int valid_cols = validCols(y);
+                int x = 0;
+                for (; x + 4 <= valid_cols; x += 4) {
+                    banks[gray[x]]++;
+                    banks[256 + gray[x + 1]]++;
+                    banks[512 + gray[x + 2]]++;
+                    banks[768 + gray[x + 3]]++;
+                }
+                for (; x < valid_cols; x++) {
+                    banks[gray[x]]++;
+                }
+            }
+        });
+
+        uint32_t histogram[256] = {};
+        for (int band = 0; band < std::max(std::min(thread_count_, output_height_), 1); band++) {
+            const uint32_t* banks = row_scratch_[band].histogram;
+            for (int i = 0; i < 256; i++) {
+                histogram[i] += banks[i] + banks[256 + i] + banks[512 + i] + banks[768 + i];
+            }
+        }
+        updateToneCurve(histogram);
+    }
+
+    char toned[256];
+    for (int i = 0; i < 256; i++) {
+        toned[i] = tables.full_range.lut[auto_contrast_ ? tone_curve_[i] : i];
+    }
+    const int levels = std::min(static_cast<int>(ascii_chars_.size()), 256) - 1;
+    const bool dither = dithering_ && levels > 0;
+    if (dither && dither_bias_.size() != static_cast<size_t>(output_width_) * 8) {
+        rebuildDitherBias();
+    }
+    const bool newline = line_stride > static_cast<size_t>(output_width_);
+
+    forEachRowBand([&](int first_row, int end_row, int band) {
+        RowScratch& scratch = row_scratch_[band];
+        for (int y = first_row; y < end_row; y++) {
+            char* line = out + y * line_stride;
+            uint8_t* gray = cell_gray_.data() + static_cast<size_t>(y) * output_width_;
+            const int valid_cols = validCols(y);
+            if (dither) {
+                if (auto_contrast_) {
+                    for (int x = 0; x < valid_cols; x++) {
+                        gray[x] = tone_curve_[gray[x]];
+                    }
+                }
+                scratch.cell_luma.resize(output_width_);
+                dither_kernel_(gray, dither_bias_.data() + static_cast<size_t>(y % 8) * output_width_,
+                               valid_cols, levels, scratch.cell_luma.data());
+                for (int x = 0; x < valid_cols; x++) {
+                    line[x] = tables.by_index[scratch.cell_luma[x]];
+                }
             } else {
-                result += ' ';
+                for (int x = 0; x < valid_cols; x++) {
+                    line[x] = toned[gray[x]];
+                }
+            }
+            std::fill(line + valid_cols, line + output_width_, tables.blank);
+            if (newline) {
+                line[output_width_] = '\n';
+            }
+        }
+    });
+}
+
+// 8x8 Bayer thresholds scaled to [0, 255), repeated across the grid width.
+void AsciiConverter::rebuildDitherBias() {
+    dither_bias_.resize(static_cast<size_t>(output_width_) * 8);
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < output_width_; x++) {
+            // Bit-reversed interleave of x ^ y and y gives the Bayer rank.
+            int v = (x ^ y) & 7, rank = 0;
+            for (int bit = 0; bit < 3; bit++) {
+                rank |= ((v >> bit) & 1) << (5 - 2 * bit);
+                rank |= ((y >> bit) & 1) << (4 - 2 * bit);
             }
+            dither_bias_[static_cast<size_t>(y) * output_width_ + x] = static_cast<uint8_t>((rank * 255 + 127) / 64);
         }
-        result += '\n';
     }
+}
 
-    return result;
-}
\ No newline at end of file
+// Stretches the 1st..99th percentile of the histogram over the full ramp,
+// with the percentiles smoothed over frames to avoid flicker.
+void AsciiConverter::updateToneCurve(const uint32_t* histogram) {
+    // Narrower spans than this would mostly amplify noise.
+    const float min_span = 48.0f;
+    uint64_t total = 0;
+    for (int i = 0; i < 256; i++) {
+        total += histogram[i];
+    }
+    if (total == 0) {
+        return;
+    }
+
+    const uint64_t tail = total / 100;
+    uint64_t count = 0;
+    int low = 0;
+    while (low < 255 && count + histogram[low] <= tail) {
+        count += histogram[low++];
+    }
+    count = 0;
+    int high = 255;
+    while (high > 0 && count + histogram[high] <= tail) {
+        count += histogram[high--];
+    }
+
+    if (contrast_primed_) {
+        contrast_low_ += contrast_smoothing_ * (low - contrast_low_);
+        contrast_high_ += contrast_smoothing_ * (high - contrast_high_);
+    } else {
+        contrast_low_ = static_cast<float>(low);
+        contrast_high_ = static_cast<float>(high);
+        contrast_primed_ = true;
+    }
+
+    float lo = contrast_low_;
+    float hi = contrast_high_;
+    if (hi - lo < min_span) {
+        float mid = (lo + hi) / 2;
+        lo = std::max(mid - min_span / 2, 0.0f);
+        hi = std::min(lo + min_span, 255.0f);
+        lo = hi - min_span;
+    }
+    const float scale = 255.0f / (hi - lo);
+    for (int i = 0; i < 256; i++) {
+        float v = (i - lo) * scale + 0.5f;
+        tone_curve_[i] = static_cast<uint8_t>(std::clamp(v, 0.0f, 255.0f));
+    }
+}
+
+// Signature of the source pixels that decide area-sampled cell (x, y)'s
+// glyph: FNV-1a over a lattice of up to 4x4 probes spread across the cell.
+uint32_t AsciiConverter::cellSignature(const VideoFrameView& frame, const SamplingGeometry& geometry,
+                                       int x, int y) const {
+    const int bytes_per_pixel = pixelStride(frame.format);
+    auto pixel = [&](const uint8_t* p) -> uint32_t {
+        return bytes_per_pixel == 1 ? p[0] : (p[0] | (p[1] << 8) | (p[2] << 16));
+    };
+
+    const int x0 = geometry.col_bounds[x], x1 = geometry.col_end[x];
+    const int y0 = geometry.row_bounds[y], y1 = geometry.row_end[y];
+    const int probes_x = std::min(x1 - x0, 4);
+    const int probes_y = std::min(y1 - y0, 4);
+    uint32_t hash = 2166136261u;
+    for (int j = 0; j < probes_y; j++) {
+        int src_y = y0 + (y1 - y0) * (2 * j + 1) / (2 * probes_y);
+        const uint8_t* row = frame.planes[0] + static_cast<ptrdiff_t>(src_y) * frame.strides[0];
+        for (int i = 0; i < probes_x; i++) {
+            int src_x = x0 + (x1 - x0) * (2 * i + 1) / (2 * probes_x);
+            hash = (hash ^ pixel(row + src_x * bytes_per_pixel)) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+// Palette index of a single area-sampled cell, matching what convertLines
+// produces.
+uint8_t AsciiConverter::convertCell(const VideoFrameView& frame, const SamplingGeometry& geometry,
+                                    int x, int y) const {
+    const bool packed = isPackedRGB(frame.format);
+    const int bytes_per_pixel = pixelStride(frame.format);
+    const int r = isBlueFirst(frame.format) ? 2 : 0;
+    const int b = 2 - r;
+    const char* luma_lut = (isYUV(frame.format) && frame.limited_range)
+        ? index_tables_.limited_range : index_tables_.full_range.lut;
+
+    const int x0 = geometry.col_bounds[x], x1 = geometry.col_end[x];
+    const int y0 = geometry.row_bounds[y], y1 = geometry.row_end[y];
+    uint32_t sums[4] = {0, 0, 0, 0};
+    for (int src_y = y0; src_y < y1; src_y++) {
+        const uint8_t* row = frame.planes[0] + static_cast<ptrdiff_t>(src_y) * frame.strides[0];
+        for (int i = x0 * bytes_per_pixel; i < x1 * bytes_per_pixel; i += bytes_per_pixel) {
+            for (int c = 0; c < bytes_per_pixel; c++) {
+                sums[c] += row[i + c];
+            }
+        }
+    }
+    uint32_t count = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+    uint8_t p[4];
+    for (int c = 0; c < bytes_per_pixel; c++) {
+        p[c] = static_cast<uint8_t>((sums[c] + count / 2) / count);
+    }
+
+    char index = packed ? index_tables_.full_range.lut[lumaFixed(p[r], p[1], p[b])] : luma_lut[p[0]];
+    return static_cast<uint8_t>(index);
+}
+
+// Refreshes cell_indices_ for the cells whose signature changed. When most of
+// the frame changed, the whole grid is reconverted with the row kernels.
+void AsciiConverter::updateChangedCells(const VideoFrameView& frame) {
+    const SamplingGeometry& geometry = geometryFor(frame);
+    const size_t cells = static_cast<size_t>(output_width_) * output_height_;
+
+    if (cells_valid_ && frame.limited_range != cells_limited_range_) {
+        cells_valid_ = false;
+    }
+    if (++frames_since_refresh_ >= refresh_interval_) {
+        cells_valid_ = false;
+    }
+    const bool refresh = !cells_valid_;
+    if (refresh) {
+        frames_since_refresh_ = 0;
+    }
+
+    cell_signatures_.resize(cells);
+    cell_indices_.resize(cells);
+    cell_dirty_.resize(cells);
+
+    forEachRowBand([&](int first_row, int end_row, int band) {
+        int dirty = 0;
+        for (int y = first_row; y < end_row; y++) {
+            size_t row = static_cast<size_t>(y) * output_width_;
+            for (int x = 0; x < output_width_; x++) {
+                uint32_t signature = cellSignature(frame, geometry, x, y);
+                bool changed = refresh || signature != cell_signatures_[row + x];
+                cell_signatures_[row + x] = signature;
+                cell_dirty_[row + x] = changed;
+                dirty += changed;
+            }
+        }
+        band_dirty_counts_[band] = dirty;
+    });
+
+    size_t dirty = 0;
+    for (int band = 0; band < std::max(std::min(thread_count_, output_height_), 1); band++) {
+        dirty += band_dirty_counts_[band];
+    }
+    dirty_fraction_ = cells > 0 ? static_cast<float>(dirty) / cells : 0.0f;
+    cells_valid_ = true;
+    cells_limited_range_ = frame.limited_range;
+
+    if (dirty * 2 > cells) {
+        convertLines(frame, index_tables_, GlyphMode::Luma, reinterpret_cast<char*>(cell_indices_.data()),
+                     output_width_);
+        return;
+    }
+    if (dirty == 0) {
+        return;
+    }
+
+    forEachRowBand([&](int first_row, int end_row, int) {
+        for (int y = first_row; y < end_row; y++) {
+            size_t row = static_cast<size_t>(y) * output_width_;
+            for (int x = 0; x < output_width_; x++) {
+                if (cell_dirty_[row + x]) {
+                    cell_indices_[row + x] = convertCell(frame, geometry, x, y);
+                }
+            }
+        }
+    });
+}
+
+// Fills scratch.lattice_luma with the lattice samples of every cell in output
+// row y: rows_per_cell rows of output_width_ * cols_per_cell samples.
+// Luma-plane formats keep their raw sample values.
+void AsciiConverter::sampleCellLattice(const VideoFrameView& frame, const CellLattice& lattice, int y,
+                                       RowScratch& scratch) {
+    const int samples_per_row = output_width_ * lattice.cols_per_cell;
+    scratch.lattice_luma.resize(static_cast<size_t>(samples_per_row) * lattice.rows_per_cell);
+    for (int j = 0; j < lattice.rows_per_cell; j++) {
+        const uint8_t* src_row = frame.planes[0] + lattice.row_offsets[y * lattice.rows_per_cell + j];
+        uint8_t* luma = scratch.lattice_luma.data() + static_cast<size_t>(j) * samples_per_row;
+        if (isPackedRGB(frame.format)) {
+            luma_kernel_(src_row, lattice.col_offsets.data(), samples_per_row, lattice.vector_cols,
+                         isBlueFirst(frame.format), gray_tables_.full_range, reinterpret_cast<char*>(luma));
+        } else {
+            for (int i = 0; i < samples_per_row; i++) {
+                luma[i] = src_row[lattice.col_offsets[i]];
+            }
+        }
+    }
+}
+
+// Encodes output row y at line and returns its length in bytes, newline
+// included.
+size_t AsciiConverter::convertUtf8Row(const VideoFrameView& frame, const SamplingGeometry& geometry, int y,
+                                      Utf8Mode mode, uint8_t threshold, RowScratch& scratch, char* line) {
+    const CellLattice& lattice = geometry.dot_lattice;
+    const int samples_per_row = output_width_ * lattice.cols_per_cell;
+    sampleCellLattice(frame, lattice, y, scratch);
+    const uint8_t* luma = scratch.lattice_luma.data();
+    char* p = line;
+
+    if (mode == Utf8Mode::Braille) {
+        // One bit per dot; cell x owns bits 2x (left) and 2x + 1 (right).
+        const int bit_bytes = (samples_per_row + 7) / 8;
+        scratch.dot_bits.resize(static_cast<size_t>(bit_bytes) * lattice.rows_per_cell);
+        for (int j = 0; j < lattice.rows_per_cell; j++) {
+            threshold_kernel_(luma + static_cast<size_t>(j) * samples_per_row, samples_per_row, threshold,
+                              scratch.dot_bits.data() + static_cast<size_t>(j) * bit_bytes);
+        }
+        const uint8_t* bits = scratch.dot_bits.data();
+        for (int x = 0; x < output_width_; x++) {
+            const int byte = x >> 2;
+            const int shift = (x & 3) * 2;
+            unsigned pattern = 0;
+            // Dots 1-3 and 4-6 run down the left and right columns; 7 and 8
+            // are the bottom row.
+            for (int j = 0; j < 3; j++) {
+                unsigned pair = (bits[j * bit_bytes + byte] >> shift) & 3;
+                pattern |= ((pair & 1) << j) | ((pair & 2) << (j + 2));
+            }
+            pattern |= ((bits[3 * bit_bytes + byte] >> shift) & 3) << 6;
+            p[0] = static_cast<char>(0xE2);
+            p[1] = static_cast<char>(0xA0 | (pattern >> 6));
+            p[2] = static_cast<char>(0x80 | (pattern & 0x3F));
+            p += 3;
+        }
+    } else {
+        // Upper half, lower half and full block are U+2580, U+2584, U+2588.
+        static const uint8_t block_tails[4] = {0, 0x80, 0x84, 0x88};
+        for (int x = 0; x < output_width_; x++) {
+            const uint8_t* r = luma + 2 * x;
+            int top = (r[0] + r[1] + r[samples_per_row] + r[samples_per_row + 1] + 2) >> 2;
+            r += 2 * samples_per_row;
+            int bottom = (r[0] + r[1] + r[samples_per_row] + r[samples_per_row + 1] + 2) >> 2;
+            int code = (top > threshold) | ((bottom > threshold) << 1);
+            if (code == 0) {
+                *p++ = ' ';
+                continue;
+            }
+            p[0] = static_cast<char>(0xE2);
+            p[1] = static_cast<char>(0x96);
+            p[2] = static_cast<char>(block_tails[code]);
+            p += 3;
+        }
+    }
+
+    *p++ = '\n';
+    return static_cast<size_t>(p - line);
+}
+
+// Sums the Sobel structure tensor over each cell's lattice. Cells with a
+// strong gradient in a dominant direction get the edge glyph across it; the
+// rest map their mean luma through the ramp. The tensor is compared in the
+// doubled-angle domain, so the two sides of a thin line reinforce each other
+// and no atan is needed.
+void AsciiConverter::convertEdgeRow(const VideoFrameView& frame, const SamplingGeometry& geometry, int y,
+                                    const OutputTables& tables, RowScratch& scratch, char* line) {
+    // Mean squared gradient a cell needs to count as an edge, and the share
+    // of it that has to agree on one orientation.
+    const int64_t min_energy = 48 * 48;
+    const double min_coherence = 0.4;
+    const int samples_per_row = output_width_ * kGlyphWidth;
+    const int cell_samples = kGlyphWidth * kGlyphHeight;
+    const char* luma_lut = (isYUV(frame.format) && frame.limited_range)
+        ? tables.limited_range : tables.full_range.lut;
+
+    sampleCellLattice(frame, geometry.shape_lattice, y, scratch);
+    scratch.gradient_x.resize(scratch.lattice_luma.size());
+    scratch.gradient_y.resize(scratch.lattice_luma.size());
+    for (int j = 0; j < kGlyphHeight; j++) {
+        const uint8_t* row = scratch.lattice_luma.data() + static_cast<size_t>(j) * samples_per_row;
+        const uint8_t* above = j > 0 ? row - samples_per_row : row;
+        const uint8_t* below = j + 1 < kGlyphHeight ? row + samples_per_row : row;
+        sobel_kernel_(above, row, below, samples_per_row,
+                      scratch.gradient_x.data() + static_cast<size_t>(j) * samples_per_row,
+                      scratch.gradient_y.data() + static_cast<size_t>(j) * samples_per_row);
+    }
+
+    for (int x = 0; x < output_width_; x++) {
+        int64_t xx = 0, yy = 0, xy = 0;
+        int sum = 0;
+        for (int j = 0; j < kGlyphHeight; j++) {
+            size_t offset = static_cast<size_t>(j) * samples_per_row + x * kGlyphWidth;
+            const int16_t* gx = scratch.gradient_x.data() + offset;
+            const int16_t* gy = scratch.gradient_y.data() + offset;
+            const uint8_t* luma = scratch.lattice_luma.data() + offset;
+            int32_t row_xx = 0, row_yy = 0, row_xy = 0;
+            for (int i = 0; i < kGlyphWidth; i++) {
+                row_xx += gx[i] * gx[i];
+                row_yy += gy[i] * gy[i];
+                row_xy += gx[i] * gy[i];
+                sum += luma[i];
+            }
+            xx += row_xx;
+            yy += row_yy;
+            xy += row_xy;
+        }
+
+        const int64_t energy = xx + yy;
+        const int64_t a = xx - yy;
+        const int64_t b = 2 * xy;
+        int edge = -1;
+        if (energy >= min_energy * cell_samples &&
+            std::hypot(static_cast<double>(a), static_cast<double>(b)) >= min_coherence * energy) {
+            // Gradient along x: vertical edge; along y: horizontal edge.
+            edge = std::llabs(a) >= std::llabs(b) ? (a > 0 ? 0 : 2) : (b > 0 ? 1 : 3);
+        }
+        if (edge >= 0 && tables.edges[edge] >= 0) {
+            line[x] = static_cast<char>(tables.edges[edge]);
+        } else {
+            line[x] = luma_lut[sum / cell_samples];
+        }
+    }
+}
+
+// Thresholds each cell of output row y into a kGlyphWidth x kGlyphHeight
+// mask at the cell's mean luma and writes the nearest palette glyph.
+void AsciiConverter::convertShapeRow(const VideoFrameView& frame, const SamplingGeometry& geometry, int y,
+                                     const OutputTables& tables, RowScratch& scratch, char* line) {
+    // Below this luma spread a cell has no outline worth matching.
+    const int min_contrast = 32;
+    const int samples_per_row = output_width_ * kGlyphWidth;
+    const bool packed = isPackedRGB(frame.format);
+    const char* luma_lut = (isYUV(frame.format) && frame.limited_range)
+        ? tables.limited_range : tables.full_range.lut;
+
+    sampleCellLattice(frame, geometry.shape_lattice, y, scratch);
+
+    const int glyph_count = static_cast<int>(shape_masks_.size());
+    for (int x = 0; x < output_width_; x++) {
+        const uint8_t* cell = scratch.lattice_luma.data() + x * kGlyphWidth;
+        int sum = 0, lo = 255, hi = 0;
+        for (int j = 0; j < kGlyphHeight; j++) {
+            const uint8_t* row = cell + static_cast<size_t>(j) * samples_per_row;
+            for (int i = 0; i < kGlyphWidth; i++) {
+                sum += row[i];
+                lo = std::min<int>(lo, row[i]);
+                hi = std::max<int>(hi, row[i]);
+            }
+        }
+        const int mean = sum / (kGlyphWidth * kGlyphHeight);
+        if (hi - lo < min_contrast || glyph_count == 0) {
+            line[x] = packed ? tables.full_range.lut[mean] : luma_lut[mean];
+            continue;
+        }
+
+        GlyphMask mask = {0, 0};
+        for (int j = 0; j < kGlyphHeight; j++) {
+            const uint8_t* row = cell + static_cast<size_t>(j) * samples_per_row;
+            uint32_t bits = 0;
+            for (int i = 0; i < kGlyphWidth; i++) {
+                bits |= static_cast<uint32_t>(row[i] > mean) << i;
+            }
+            if (j < 8) {
+                mask.rows_lo |= static_cast<uint64_t>(bits) << (j * 8);
+            } else {
+                mask.rows_hi |= bits << ((j - 8) * 8);
+            }
+        }
+
+        int best = 0;
+        int best_distance = shiftedHammingDistance(mask, shape_masks_[0]);
+        for (int i = 1; i < glyph_count && best_distance > 0; i++) {
+            int distance = shiftedHammingDistance(mask, shape_masks_[i]);
+            if (distance < best_distance) {
+                best = i;
+                best_distance = distance;
+            }
+        }
+        line[x] = tables.by_index[best];
+    }
+}
+
+void AsciiConverter::convertLines(const VideoFrameView& frame, const OutputTables& tables, GlyphMode mode,
+                                  char* out, size_t line_stride) {
+    const bool newline = line_stride > static_cast<size_t>(output_width_);
+    const GlyphTable& table = tables.full_range;
+    const SamplingGeometry& geometry = geometryFor(frame);
+    const bool packed = isPackedRGB(frame.format);
+    const bool blue_first = isBlueFirst(frame.format);
+    const int bytes_per_pixel = pixelStride(frame.format);
+    const int r = blue_first ? 2 : 0;
+    const int b = 2 - r;
+    // Luma-plane formats map their samples straight through a glyph table.
+    const char* luma_lut = (isYUV(frame.format) && frame.limited_range) ? tables.limited_range : table.lut;
+
+    forEachRowBand([&](int first_row, int end_row, int band) {
+        for (int y = first_row; y < end_row; y++) {
+            char* line = out + y * line_stride;
+            if (newline) {
+                line[output_width_] = '\n';
+            }
+
+            if (mode == GlyphMode::Shape) {
+                convertShapeRow(frame, geometry, y, tables, row_scratch_[band], line);
+                continue;
+            }
+            if (mode == GlyphMode::Edges) {
+                convertEdgeRow(frame, geometry, y, tables, row_scratch_[band], line);
+                continue;
+            }
+
+            if (sampling_mode_ == SamplingMode::Area) {
+                RowScratch& scratch = row_scratch_[band];
+                averagePlaneRow(frame.planes[0], frame.strides[0], frame.width, bytes_per_pixel,
+                                geometry.col_bounds.data(), geometry.col_end.data(),
+                                geometry.row_bounds[y], geometry.row_end[y], scratch, scratch.plane_avg);
+                const uint8_t* avg = scratch.plane_avg.data();
+                for (int x = 0; x < output_width_; x++) {
+                    if (packed) {
+                        const uint8_t* p = avg + x * bytes_per_pixel;
+                        line[x] = table.lut[lumaFixed(p[r], p[1], p[b])];
+                    } else {
+                        line[x] = luma_lut[avg[x]];
+                    }
+                }
+                continue;
+            }
+
+            int valid_cols = geometry.row_offsets[y] < 0 ? 0 : geometry.valid_cols;
+            std::fill(line + valid_cols, line + output_width_, tables.blank);
+            if (valid_cols == 0) {
+                continue;
+            }
+
+            const uint8_t* src_row = frame.planes[0] + geometry.row_offsets[y];
+            if (packed) {
+                luma_kernel_(src_row, geometry.col_offsets.data(), valid_cols,
+                             geometry.row_vector_cols[y], blue_first, table, line);
+            } else {
+                for (int x = 0; x < valid_cols; x++) {
+                    line[x] = luma_lut[src_row[geometry.col_offsets[x]]];
+                }
+            }
+        }
+    });
+}
+
+void AsciiConverter::convertLayerLines(const VideoFrameView& frame, char* red_out, char* green_out, char* blue_out) {
+    const int line_length = output_width_ + 1;
+    const SamplingGeometry& geometry = geometryFor(frame);
+
+    // One pass over the sampled pixels feeds all three channel layers.
+    forEachRowBand([&](int first_row, int end_row, int band) {
+        for (int y = first_row; y < end_row; y++) {
+            char* red = red_out + static_cast<size_t>(y) * line_length;
+            char* green = green_out + static_cast<size_t>(y) * line_length;
+            char* blue = blue_out + static_cast<size_t>(y) * line_length;
+            red[output_width_] = '\n';
+            green[output_width_] = '\n';
+            blue[output_width_] = '\n';
+
+            RowScratch& scratch = row_scratch_[band];
+            int valid_cols = sampleRowColor(frame, geometry, y, scratch);
+            std::fill(red + valid_cols, red + output_width_, ' ');
+            std::fill(green + valid_cols, green + output_width_, ' ');
+            std::fill(blue + valid_cols, blue + output_width_, ' ');
+
+            const uint8_t* rgb = scratch.cell_rgb.data();
+            for (int x = 0; x < valid_cols; x++) {
+                red[x] = glyph_tables_.full_range.lut[rgb[x * 3]];
+                green[x] = glyph_tables_.full_range.lut[rgb[x * 3 + 1]];
+                blue[x] = glyph_tables_.full_range.lut[rgb[x * 3 + 2]];
+            }
+        }
+    });
+}
@@ -1,7 +1,19 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
+#include "ascii_frame.h"
+#include "ascii_kernels.h"
+#include "glyph_bitmaps.h"
+#include "kernel_tune_cache.h"
+#include "sampling_geometry.h"
+#include "thread_pool.h"
+#include "video_frame.h"
 
 struct AsciiLayers {
     std::string red_layer;
@@ -9,22 +21,349 @@ struct AsciiLayers {
     std::string blue_layer;
 };
 
+enum class SamplingMode {
+    Nearest,    // one source pixel per cell
+    Area        // box filter over every source pixel the cell covers
+};
+
+enum class GlyphMode {
+    Luma,       // glyph density follows cell brightness
+    Shape,      // glyph whose bitmap best matches the cell's thresholded outline
+    Edges       // | / - \ along strong edges, luma ramp elsewhere
+};
+
+struct GridSize {
+    int width;
+    int height;
+};
+
+enum class Utf8Mode {
+    HalfBlock,  // space, upper, lower or full block from each cell's two halves
+    Braille     // 2x4 dots per cell, U+2800..U+28FF
+};
+
+// Setters may be called from any thread while another thread converts: they
+// publish an immutable settings snapshot that the converting thread picks up
+// at the start of its next frame. The snapshot carries the tables, worker pool
+// and sampling geometry (for the last frame layout converted) those settings
+// need, so adopting it costs the converting thread a few swaps; only a new
+// input layout builds its geometry on that thread. Getters report the latest
+// requested values, which the next conversion may not have adopted yet.
+// Conversions themselves must stay on one thread at a time.
 class AsciiConverter {
 public:
     AsciiConverter(int output_width = 120, int output_height = 40);
+    ~AsciiConverter();
+
+    AsciiConverter(const AsciiConverter&) = delete;
+    AsciiConverter& operator=(const AsciiConverter&) = delete;
 
     std::string convertRGBBuffer(const uint8_t* rgb_buffer, int width, int height);
     AsciiLayers convertRGBBufferToLayers(const uint8_t* rgb_buffer, int width, int height);
 
+    // Same output as above, written into caller-owned frames. Once the frames
+    // have been sized by a first call these allocate nothing.
+    void convertInto(const uint8_t* rgb_buffer, int width, int height, AsciiFrame& frame);
+    void convertLayersInto(const uint8_t* rgb_buffer, int width, int height, AsciiLayerFrames& layers);
+
+    // Any supported layout and row stride. YUV and GRAY8 frames are read from
+    // the luma plane directly; layers of YUV frames use the chroma planes too.
+    void convertInto(const VideoFrameView& frame, AsciiFrame& out);
+    void convertLayersInto(const VideoFrameView& frame, AsciiLayerFrames& layers);
+
+    // Palette indices instead of glyphs, packed two per byte when the palette
+    // has at most 16 entries. Cells outside the source frame get index 0.
+    void convertIndicesInto(const VideoFrameView& frame, GlyphIndexFrame& out);
+
+    // As above, and fills delta with the runs of cells that changed since the
+    // previous call of this overload. The first frame is a keyframe, as is
+    // the first after a size or palette change or requestKeyframe().
+    void convertIndicesInto(const VideoFrameView& frame, GlyphIndexFrame& out, GlyphDelta& delta);
+    void requestKeyframe() { keyframe_requested_ = true; }
+
+    // Text at several grid sizes from one pass over the source: cells are
+    // sampled once at the converter's own grid and each of sizes is box
+    // filtered from those gray levels. levels[i] receives sizes[i]. Returns
+    // false without converting when a size is wider or taller than the grid,
+    // which would need finer sampling than the pass provides. Always uses
+    // the plain luma ramp. Pays off with area sampling, where reading the
+    // source dominates.
+    bool convertPyramidInto(const VideoFrameView& frame, const std::vector<GridSize>& sizes,
+                            std::vector<AsciiFrame>& levels);
+
+    // Palette index plus the sampled colour of every cell, from one pass.
+    void convertColorInto(const VideoFrameView& frame, ColorAsciiFrame& out);
+
+    // Sub-cell detail as UTF-8 text: every cell samples a 2x4 dot lattice and
+    // thresholds it (half blocks average each 2x2 half first) at the dot
+    // threshold, a full-range luma level.
+    void convertUtf8Into(const VideoFrameView& frame, Utf8Mode mode, Utf8Frame& out);
+    void setDotThreshold(uint8_t threshold);
+    uint8_t getDotThreshold() const { return setting(&Settings::dot_threshold); }
+
     void setOutputSize(int width, int height);
+    int getOutputWidth() const { return setting(&Settings::output_width); }
+    int getOutputHeight() const { return setting(&Settings::output_height); }
     void setAsciiChars(const std::string& chars);
+    std::string getAsciiChars() const { return setting(&Settings::ascii_chars); }
+    void setSamplingMode(SamplingMode mode);
+    SamplingMode getSamplingMode() const { return setting(&Settings::sampling_mode); }
+
+    // Shape mode samples kGlyphWidth x kGlyphHeight points per cell, marks
+    // those brighter than the cell mean and picks the palette glyph at the
+    // lowest Hamming distance, trying each glyph one column off centre too;
+    // low-contrast cells fall back to the luma ramp.
+    // Edges mode runs a Sobel filter over the same lattice and draws cells
+    // with a strong, consistently oriented gradient as | / - or \. Index
+    // output can only use edge glyphs that appear in the palette.
+    // Both apply to text and index output and bypass change detection.
+    void setGlyphMode(GlyphMode mode);
+    GlyphMode getGlyphMode() const { return setting(&Settings::glyph_mode); }
+
+    // Overrides the CPU-dispatched kernel; returns false if the CPU lacks it.
+    bool setKernelIsa(KernelIsa isa);
+    KernelIsa getKernelIsa() const { return setting(&Settings::kernel_isa); }
+
+    // Opt-in: keeps a signature of each cell's source pixels and reconverts
+    // only cells whose signature changed, reusing the previous glyph for the
+    // rest. Applies to convertRGBBuffer, convertInto and convertIndicesInto
+    // with area sampling and palettes of at most 256 glyphs; other settings
+    // convert every cell. The signature probes up to 4x4 pixels per cell, so
+    // changes between probes of larger cells can go unseen until every cell
+    // is reconverted each refresh_interval frames.
+    void setChangeDetection(bool enabled, int refresh_interval = 30);
+    bool getChangeDetection() const { return setting(&Settings::change_detection); }
+    // Fraction of cells reconverted for the last frame (1 when not tracking).
+    float getDirtyFraction() const { return dirty_fraction_; }
+
+    // Opt-in: stretches the range the cells actually use (1st to 99th
+    // percentile of their luma histogram) over the whole glyph ramp. The
+    // percentiles follow the scene with the given per-frame smoothing, 1
+    // meaning no smoothing; values below 0.01 are raised to it so the curve
+    // keeps adapting. Applies to luma-mode text and index output and
+    // bypasses change detection.
+    void setAutoContrast(bool enabled, float smoothing = 0.1f);
+    bool getAutoContrast() const { return setting(&Settings::auto_contrast); }
+
+    // Ordered dithering between neighbouring glyphs with an 8x8 Bayer matrix,
+    // so gradients come out as patterns instead of bands. Every cell is
+    // quantized independently. Applies where auto-contrast does.
+    void setDithering(bool enabled);
+    bool getDithering() const { return setting(&Settings::dithering); }
+
+    // Splits output rows into bands converted by a persistent worker pool.
+    // 1 (the default) converts on the calling thread only.
+    void setThreadCount(int threads);
+    int getThreadCount() const { return setting(&Settings::thread_count); }
+
+    // Opt-in: the first time a geometry (input format and size, grid size,
+    // sampling and glyph mode) is seen, a background thread times text
+    // conversions of a copy of that frame with every supported ISA and a
+    // range of thread counts. Conversions carry on with the kernels in use
+    // until a later frame adopts the fastest, replacing setKernelIsa and
+    // setThreadCount. Choices are saved to cache_path, when given, and reused
+    // without benchmarking by later runs. Disable it to force a kernel for
+    // reproducible measurements.
+    void setAutotune(bool enabled, const std::string& cache_path = "");
+    bool getAutotune() const { return setting(&Settings::autotune); }
+
+    // ISA and thread count the last conversion ran with, tuned or not.
+    KernelChoice getActiveKernels() const { return active_kernels_.load(std::memory_order_relaxed); }
 
 private:
+    // Maps sampled values to output bytes: glyphs for text, palette indices
+    // for index frames.
+    struct OutputTables {
+        GlyphTable full_range;
+        char limited_range[256];    // for limited-range (16..235) YUV luma
+        char blank;                 // for cells outside the source frame
+        char by_index[256];         // palette index -> output byte
+        int edges[4];               // | / - \ output bytes, -1 if unavailable
+    };
+
+    // Everything the setters control.
+    struct Settings {
+        int output_width = 120;
+        int output_height = 40;
+        std::string ascii_chars = " .:-=+*#%@";
+        SamplingMode sampling_mode = SamplingMode::Nearest;
+        GlyphMode glyph_mode = GlyphMode::Luma;
+        KernelIsa kernel_isa = bestKernelIsa();
+        int thread_count = 1;
+        bool change_detection = false;
+        int refresh_interval = 30;
+        uint8_t dot_threshold = 128;
+        bool auto_contrast = false;
+        float contrast_smoothing = 0.1f;
+        bool dithering = false;
+        bool autotune = false;
+        std::string autotune_cache;
+    };
+
+    // Settings plus what derives from them, built by the setter so the
+    // converting thread only has to copy or swap it in. thread_pool is null
+    // when the thread count did not change; geometry is null until a frame
+    // has been converted.
+    struct Snapshot {
+        Settings settings;
+        OutputTables glyph_tables;
+        OutputTables index_tables;
+        OutputTables gray_tables;
+        std::vector<GlyphMask> shape_masks;
+        std::unique_ptr<ThreadPool> thread_pool;
+        std::shared_ptr<const SamplingGeometry> geometry;
+    };
+
+    // Setter side: the latest requested settings, the newest snapshot not yet
+    // adopted by the converting thread and the thread count it was built for.
+    mutable std::mutex settings_mutex_;
+    Settings settings_;
+    std::atomic<Snapshot*> pending_snapshot_;
+    std::atomic<bool> keyframe_requested_;
+    int published_threads_;
+
+    // Layout (planes unset) of the last frame whose geometry the converting
+    // thread built, for setters to prepare geometries from.
+    std::mutex layout_mutex_;
+    VideoFrameView frame_layout_;
+
+    // Converting thread side: the adopted settings.
     int output_width_;
     int output_height_;
     std::string ascii_chars_;
+    SamplingMode sampling_mode_;
+    GlyphMode glyph_mode_;
+    OutputTables glyph_tables_;
+    OutputTables index_tables_;
+    AlignedBuffer index_scratch_;
+    OutputTables gray_tables_;              // full-range gray level per cell
+    std::vector<GlyphMask> shape_masks_;    // bitmap of each palette glyph
+    GlyphIndexFrame previous_indices_;
+    bool keyframe_pending_;
+    KernelIsa kernel_isa_;
+    LumaRowKernel luma_kernel_;
+    AccumulateRowKernel accumulate_kernel_;
+    SobelRowKernel sobel_kernel_;
+    ThresholdBitsKernel threshold_kernel_;
+    uint8_t dot_threshold_;
+    std::vector<size_t> line_lengths_;
 
-    uint8_t rgbToGray(uint8_t r, uint8_t g, uint8_t b) const;
-    char grayToAscii(uint8_t gray) const;
-    std::string convertSingleChannel(const uint8_t* rgb_buffer, int width, int height, int channel);
-};
\ No newline at end of file
+    // Auto-contrast state
+    bool auto_contrast_;
+    float contrast_smoothing_;
+    float contrast_low_;
+    float contrast_high_;
+    bool contrast_primed_;
+    uint8_t tone_curve_[256];
+    std::vector<uint8_t> cell_gray_;
+
+    bool dithering_;
+    DitherRowKernel dither_kernel_;
+    std::vector<uint8_t> dither_bias_;      // 8 rows of output_width_ thresholds
+    std::vector<uint32_t> pyramid_sums_;    // one level row's column sums
+    std::vector<int> pyramid_cols_;         // grid column range of each level cell
+    std::shared_ptr<const SamplingGeometry> geometry_;
+    std::shared_ptr<const SamplingGeometry> prepared_geometry_;    // from the last snapshot
+
+    int thread_count_;
+    std::unique_ptr<ThreadPool> thread_pool_;
+    std::atomic<KernelChoice> active_kernels_;    // kernel_isa_ and thread_count_ for other threads
+
+    // Autotuning state. tuned_key_ names the geometry the kernels were, or
+    // are being, tuned for and is empty until the current one has been seen.
+    // tune_jobs_ holds the background runs not yet collected; only one for
+    // tuned_key_ can be live, the others have been cancelled.
+    struct TuneJob;
+    bool autotune_;
+    std::string tune_cache_path_;
+    std::string tuned_key_;
+    std::vector<std::unique_ptr<TuneJob>> tune_jobs_;
+
+    // Change detection state
+    bool change_detection_;
+    int refresh_interval_;
+    int frames_since_refresh_;
+    bool cells_valid_;
+    bool cells_limited_range_;
+    std::atomic<float> dirty_fraction_;
+    std::vector<uint32_t> cell_signatures_;
+    std::vector<uint8_t> cell_indices_;
+    std::vector<uint8_t> cell_dirty_;
+    std::vector<int> band_dirty_counts_;
+
+    // Per-row sampling scratch, one per row band
+    struct RowScratch {
+        std::vector<uint16_t> row_sums;
+        std::vector<uint32_t> cell_sums;
+        std::vector<uint8_t> plane_avg;
+        std::vector<uint8_t> chroma_avg[2];
+        std::vector<uint8_t> cell_rgb;
+        std::vector<uint8_t> cell_luma;
+        std::vector<uint8_t> lattice_luma;
+        std::vector<int16_t> gradient_x;
+        std::vector<int16_t> gradient_y;
+        std::vector<uint8_t> dot_bits;
+        uint32_t histogram[4 * 256];
+    };
+    std::vector<RowScratch> row_scratch_;
+
+    const SamplingGeometry& geometryFor(const VideoFrameView& frame);
+    void autotuneFor(const VideoFrameView& frame);
+    void collectTuneJobs();
+    static void runTuneJob(TuneJob& job);
+    void useKernels(KernelIsa isa, int threads, std::unique_ptr<ThreadPool> pool = nullptr);
+    void writeLines(const VideoFrameView& frame, const OutputTables& tables, char* out, size_t line_stride);
+    void convertLines(const VideoFrameView& frame, const OutputTables& tables, GlyphMode mode,
+                      char* out, size_t line_stride);
+    void downsampleCells(const uint8_t* gray, GridSize size, AsciiFrame& out);
+    void sampleCellLattice(const VideoFrameView& frame, const CellLattice& lattice, int y, RowScratch& scratch);
+    size_t convertUtf8Row(const VideoFrameView& frame, const SamplingGeometry& geometry, int y, Utf8Mode mode,
+                          uint8_t threshold, RowScratch& scratch, char* line);
+    void convertEdgeRow(const VideoFrameView& frame, const SamplingGeometry& geometry, int y,
+                        const OutputTables& tables, RowScratch& scratch, char* line);
+    void convertShapeRow(const VideoFrameView& frame, const SamplingGeometry& geometry, int y,
+                         const OutputTables& tables, RowScratch& scratch, char* line);
+    void convertToned(const VideoFrameView& frame, const OutputTables& tables, char* out, size_t line_stride);
+    void updateToneCurve(const uint32_t* histogram);
+    void rebuildDitherBias();
+    void updateChangedCells(const VideoFrameView& frame);
+    uint32_t cellSignature(const VideoFrameView& frame, const SamplingGeometry& geometry, int x, int y) const;
+    uint8_t convertCell(const VideoFrameView& frame, const SamplingGeometry& geometry, int x, int y) const;
+    void convertLayerLines(const VideoFrameView& frame, char* red_out, char* green_out, char* blue_out);
+    void averagePlaneRow(const uint8_t* plane, int stride, int plane_width, int channels,
+                         const int* col_begin, const int* col_end, int row_begin, int row_end,
+                         RowScratch& scratch, std::vector<uint8_t>& out);
+    int sampleRowColor(const VideoFrameView& frame, const SamplingGeometry& geometry, int y, RowScratch& scratch);
+
+    // One field of the requested settings.
+    template <typename T>
+    T setting(T Settings::*field) const {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        return settings_.*field;
+    }
+    // Applies update to the settings and publishes the result.
+    template <typename Update>
+    void updateSettings(Update&& update) {
+        std::lock_guard<std::mutex> lock(settings_mutex_);
+        update(settings_);
+        publishSettings();
+    }
+    void publishSettings();
+    void adoptSettings();
+    void applySnapshot(Snapshot& snapshot);
+    static void buildTables(Snapshot& snapshot);
+
+    // Calls convert_rows(first_row, end_row, band) for each row band, in
+    // parallel when a thread pool is configured.
+    template <typename ConvertRows>
+    void forEachRowBand(ConvertRows&& convert_rows) {
+        int bands = std::min(thread_count_, output_height_);
+        if (bands <= 1) {
+            convert_rows(0, output_height_, 0);
+            return;
+        }
+        thread_pool_->run(bands, [&](int band) {
+            convert_rows(band * output_height_ / bands, (band + 1) * output_height_ / bands, band);
+        });
+    }
+};
@@ -0,0 +1,81 @@
+#include "ascii_frame.h"
+#include "ascii_kernels.h"
+#include <algorithm>
+
+void packNibbles(const uint8_t* src, int count, uint8_t* dst) {
+    int x = 0;
+    for (; x + 1 < count; x += 2) {
+        dst[x / 2] = static_cast<uint8_t>(src[x] | (src[x + 1] << 4));
+    }
+    if (x < count) {
+        dst[x / 2] = src[x];
+    }
+}
+
+void GlyphIndexFrame::toText(const std::string& palette, AsciiFrame& out) const {
+    char glyphs[256];
+    for (int i = 0; i < 256; i++) {
+        glyphs[i] = i < static_cast<int>(palette.size()) ? palette[i] : ' ';
+    }
+
+    out.resize(width, height);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* src = row(y);
+        char* line = out.line(y);
+        if (bits == 4) {
+            for (int x = 0; x < width; x++) {
+                line[x] = glyphs[(src[x / 2] >> ((x & 1) * 4)) & 0x0F];
+            }
+        } else {
+            for (int x = 0; x < width; x++) {
+                line[x] = glyphs[src[x]];
+            }
+        }
+        line[width] = '\n';
+    }
+}
+
+size_t GlyphDelta::changedCells() const {
+    size_t cells = 0;
+    for (const CellRun& run : runs) {
+        cells += run.length;
+    }
+    return cells;
+}
+
+void diffGlyphIndices(const GlyphIndexFrame& previous, const GlyphIndexFrame& current, GlyphDelta& delta,
+                      KernelIsa isa) {
+    const ScanBytesKernel scan = scanBytesKernel(isa);
+
+    delta.runs.clear();
+    delta.keyframe = previous.width != current.width || previous.height != current.height ||
+                     previous.bits != current.bits || current.indices.size() == 0;
+    if (delta.keyframe) {
+        return;
+    }
+
+    for (int y = 0; y < current.height; y++) {
+        const uint8_t* old_row = previous.row(y);
+        const uint8_t* new_row = current.row(y);
+        int i = scan(old_row, new_row, 0, current.row_bytes, true);
+        while (i < current.row_bytes) {
+            int end = scan(old_row, new_row, i, current.row_bytes, false);
+            int x = i;
+            int x_end = end;
+            if (current.bits == 4) {
+                // Trim the nibbles at either end that did not change.
+                x = 2 * i + (((old_row[i] ^ new_row[i]) & 0x0F) ? 0 : 1);
+                x_end = 2 * (end - 1) + (((old_row[end - 1] ^ new_row[end - 1]) & 0xF0) ? 2 : 1);
+                // The high nibble past an odd width is padding, not a cell.
+                x_end = std::min(x_end, current.width);
+                while (x_end > x && previous.index(x_end - 1, y) == current.index(x_end - 1, y)) {
+                    x_end--;
+                }
+            }
+            if (x_end > x) {
+                delta.runs.push_back({y, x, x_end - x});
+            }
+            i = end < current.row_bytes ? scan(old_row, new_row, end, current.row_bytes, true) : end;
+        }
+    }
+}
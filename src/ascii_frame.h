@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "ascii_kernels.h"
+
+constexpr size_t kCacheLineSize = 64;
+
+// Cache-line aligned byte buffer that only reallocates when it has to grow,
+// so a buffer reused across frames of the same size never touches the heap.
+class AlignedBuffer {
+public:
+    AlignedBuffer() = default;
+    ~AlignedBuffer() { release(); }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    AlignedBuffer(AlignedBuffer&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr))
+        , size_(std::exchange(other.size_, 0))
+        , capacity_(std::exchange(other.capacity_, 0)) {
+    }
+
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+        if (this != &other) {
+            release();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            capacity_ = std::exchange(other.capacity_, 0);
+        }
+        return *this;
+    }
+
+    void resize(size_t size) {
+        if (size > capacity_) {
+            release();
+            capacity_ = (size + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+            data_ = static_cast<uint8_t*>(::operator new(capacity_, std::align_val_t(kCacheLineSize)));
+        }
+        size_ = size;
+    }
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+
+    void release() {
+        if (data_) {
+            ::operator delete(data_, std::align_val_t(kCacheLineSize));
+            data_ = nullptr;
+        }
+    }
+};
+
+// One converted frame: height lines of width glyphs, each ending in '\n',
+// laid out exactly like the strings returned by convertRGBBuffer.
+struct AsciiFrame {
+    int width = 0;
+    int height = 0;
+    AlignedBuffer text;
+
+    void resize(int cols, int rows) {
+        width = cols;
+        height = rows;
+        text.resize(static_cast<size_t>(rows) * (cols + 1));
+    }
+
+    char* line(int y) { return reinterpret_cast<char*>(text.data()) + static_cast<size_t>(y) * (width + 1); }
+    std::string_view view() const {
+        return std::string_view(reinterpret_cast<const char*>(text.data()), text.size());
+    }
+    bool empty() const { return text.size() == 0; }
+};
+
+// UTF-8 text with width cells per line but a variable number of bytes per
+// cell. The buffer is sized for the longest encoding of the grid, so frames
+// of the same size never reallocate; text.size() is the encoded length.
+struct Utf8Frame {
+    int width = 0;
+    int height = 0;
+    AlignedBuffer text;
+
+    void reserve(int cols, int rows, int max_bytes_per_cell) {
+        width = cols;
+        height = rows;
+        text.resize(static_cast<size_t>(rows) * (static_cast<size_t>(cols) * max_bytes_per_cell + 1));
+    }
+
+    std::string_view view() const {
+        return std::string_view(reinterpret_cast<const char*>(text.data()), text.size());
+    }
+};
+
+struct AsciiLayerFrames {
+    AsciiFrame red;
+    AsciiFrame green;
+    AsciiFrame blue;
+};
+
+// Palette indices for one converted frame, one row of row_bytes per grid row.
+// With bits == 4 two cells share a byte, the even column in the low nibble.
+// Consumers that need text apply a palette with toText().
+struct GlyphIndexFrame {
+    int width = 0;
+    int height = 0;
+    int bits = 8;
+    int row_bytes = 0;
+    AlignedBuffer indices;
+
+    void resize(int cols, int rows, int index_bits) {
+        width = cols;
+        height = rows;
+        bits = index_bits;
+        row_bytes = bits == 4 ? (cols + 1) / 2 : cols;
+        indices.resize(static_cast<size_t>(rows) * row_bytes);
+    }
+
+    uint8_t* row(int y) { return indices.data() + static_cast<size_t>(y) * row_bytes; }
+    const uint8_t* row(int y) const { return indices.data() + static_cast<size_t>(y) * row_bytes; }
+
+    uint8_t index(int x, int y) const {
+        const uint8_t* r = row(y);
+        return bits == 4 ? (r[x / 2] >> ((x & 1) * 4)) & 0x0F : r[x];
+    }
+
+    void toText(const std::string& palette, AsciiFrame& out) const;
+};
+
+// Horizontal run of cells in row y that changed since the previous frame.
+struct CellRun {
+    int y;
+    int x;
+    int length;
+};
+
+// What changed between two consecutive index frames. A keyframe means every
+// cell has to be redrawn; runs is then empty.
+struct GlyphDelta {
+    bool keyframe = true;
+    std::vector<CellRun> runs;
+
+    size_t changedCells() const;
+};
+
+// Runs of cells that differ between previous and current, or a keyframe when
+// their dimensions or index widths differ. In 4-bit frames a run may include
+// an unchanged cell that shares a byte with changed ones. Rows are compared
+// with the scan kernel of isa.
+void diffGlyphIndices(const GlyphIndexFrame& previous, const GlyphIndexFrame& current, GlyphDelta& delta,
+                      KernelIsa isa);
+
+// Packs count 4-bit indices (one per byte in src) two per byte into dst.
+void packNibbles(const uint8_t* src, int count, uint8_t* dst);
+
+// Per-cell glyph and colour in struct-of-arrays form: four planes of
+// width * height bytes, each starting on a cache line, ready for vector loads
+// or a single-channel texture upload apiece. glyphs holds palette indices.
+struct ColorAsciiFrame {
+    int width = 0;
+    int height = 0;
+    AlignedBuffer glyphs;
+    AlignedBuffer red;
+    AlignedBuffer green;
+    AlignedBuffer blue;
+
+    void resize(int cols, int rows) {
+        width = cols;
+        height = rows;
+        size_t cells = static_cast<size_t>(cols) * rows;
+        glyphs.resize(cells);
+        red.resize(cells);
+        green.resize(cells);
+        blue.resize(cells);
+    }
+};
@@ -0,0 +1,573 @@
+#include "ascii_kernels.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ASCII_KERNELS_X86 1
+#endif
+
+void buildGlyphTable(GlyphTable& table, const std::string& ascii_chars) {
+    int n = static_cast<int>(ascii_chars.length());
+    table.palette_size = n;
+
+    memset(table.palette, ' ', sizeof(table.palette));
+    for (int i = 0; i < std::min(n, 16); i++) {
+        table.palette[i] = ascii_chars[i];
+    }
+
+    for (int gray = 0; gray < 256; gray++) {
+        if (n == 0) {
+            table.lut[gray] = ' ';
+            continue;
+        }
+        int char_index = (gray * (n - 1)) / 255;
+        table.lut[gray] = ascii_chars[std::clamp(char_index, 0, n - 1)];
+    }
+}
+
+static void lumaRowScalar(const uint8_t* src_row, const int* col_offsets,
+                          int count, int vector_count, bool blue_first,
+                          const GlyphTable& table, char* out) {
+    (void)vector_count;
+    const int r = blue_first ? 2 : 0;
+    const int b = 2 - r;
+    for (int x = 0; x < count; x++) {
+        const uint8_t* p = src_row + col_offsets[x];
+        out[x] = table.lut[lumaFixed(p[r], p[1], p[b])];
+    }
+}
+
+static void accumulateRowScalar(const uint8_t* src, uint16_t* acc, int count) {
+    for (int i = 0; i < count; i++) {
+        acc[i] = static_cast<uint16_t>(acc[i] + src[i]);
+    }
+}
+
+static int scanBytesScalar(const uint8_t* a, const uint8_t* b, int begin, int count, bool find_different) {
+    int i = begin;
+    while (i < count && (a[i] != b[i]) != find_different) {
+        i++;
+    }
+    return i;
+}
+
+static inline void sobelAt(const uint8_t* a, const uint8_t* r, const uint8_t* b,
+                           int left, int x, int right, int16_t* gx, int16_t* gy) {
+    gx[x] = static_cast<int16_t>((a[right] + 2 * r[right] + b[right]) - (a[left] + 2 * r[left] + b[left]));
+    gy[x] = static_cast<int16_t>((b[left] + 2 * b[x] + b[right]) - (a[left] + 2 * a[x] + a[right]));
+}
+
+static void sobelRowScalar(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+                           int count, int16_t* gx, int16_t* gy) {
+    for (int x = 0; x < count; x++) {
+        sobelAt(above, row, below, std::max(x - 1, 0), x, std::min(x + 1, count - 1), gx, gy);
+    }
+}
+
+static void thresholdBitsScalar(const uint8_t* src, int count, uint8_t threshold, uint8_t* bits) {
+    for (int i = 0; i < count; i += 8) {
+        uint8_t byte = 0;
+        for (int b = 0; b < 8 && i + b < count; b++) {
+            byte |= static_cast<uint8_t>((src[i + b] > threshold) << b);
+        }
+        bits[i / 8] = byte;
+    }
+}
+
+static void ditherRowScalar(const uint8_t* gray, const uint8_t* bias, int count, int levels, uint8_t* index) {
+    for (int i = 0; i < count; i++) {
+        index[i] = static_cast<uint8_t>((gray[i] * levels + bias[i]) / 255);
+    }
+}
+
+static void rgb555LookupScalar(const uint8_t* r, const uint8_t* g, const uint8_t* b, int count,
+                               const uint8_t* lut, uint8_t* out) {
+    for (int i = 0; i < count; i++) {
+        out[i] = lut[(r[i] >> 3) << 10 | (g[i] >> 3) << 5 | b[i] >> 3];
+    }
+}
+
+#ifdef ASCII_KERNELS_X86
+
+static inline int32_t loadPixel(const uint8_t* p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Luma weights in byte order for one pixel, repeated across the register.
+__attribute__((target("sse4.1")))
+static inline __m128i lumaCoefSSE(bool blue_first) {
+    return blue_first ? _mm_setr_epi16(3735, 19235, 9798, 0, 3735, 19235, 9798, 0)
+                      : _mm_setr_epi16(9798, 19235, 3735, 0, 9798, 19235, 3735, 0);
+}
+
+// Luma of four packed pixels (r, g, b, junk) held in 32-bit lanes.
+__attribute__((target("sse4.1")))
+static inline __m128i luma4SSE(__m128i px, __m128i coef) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), coef);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), coef);
+    return _mm_srli_epi32(_mm_hadd_epi32(lo, hi), 15);
+}
+
+// gray * (n - 1) / 255 for 16-bit lanes, exact for every palette up to 256 entries.
+__attribute__((target("sse4.1")))
+static inline __m128i glyphIndexSSE(__m128i gray16, __m128i scale) {
+    __m128i x = _mm_mullo_epi16(gray16, scale);
+    x = _mm_add_epi16(x, _mm_add_epi16(_mm_srli_epi16(x, 8), _mm_set1_epi16(1)));
+    return _mm_srli_epi16(x, 8);
+}
+
+// Maps 16 gray bytes to glyphs, shuffling from the palette register when it fits.
+__attribute__((target("sse4.1")))
+static inline void storeGlyphs16SSE(__m128i g_lo, __m128i g_hi,
+                                    const GlyphTable& table, char* out) {
+    if (table.palette_size > 0 && table.palette_size <= 16) {
+        __m128i scale = _mm_set1_epi16(static_cast<short>(table.palette_size - 1));
+        __m128i idx = _mm_packus_epi16(glyphIndexSSE(g_lo, scale), glyphIndexSSE(g_hi, scale));
+        __m128i palette = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.palette));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(palette, idx));
+    } else {
+        alignas(16) uint8_t gray[16];
+        _mm_store_si128(reinterpret_cast<__m128i*>(gray), _mm_packus_epi16(g_lo, g_hi));
+        for (int i = 0; i < 16; i++) {
+            out[i] = table.lut[gray[i]];
+        }
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void lumaRowSSE41(const uint8_t* src_row, const int* col_offsets,
+                         int count, int vector_count, bool blue_first,
+                         const GlyphTable& table, char* out) {
+    const __m128i coef = lumaCoefSSE(blue_first);
+    int x = 0;
+    for (; x + 16 <= vector_count; x += 16) {
+        const int* o = col_offsets + x;
+        __m128i y[4];
+        for (int i = 0; i < 4; i++) {
+            __m128i px = _mm_setr_epi32(loadPixel(src_row + o[i * 4]),
+                                        loadPixel(src_row + o[i * 4 + 1]),
+                                        loadPixel(src_row + o[i * 4 + 2]),
+                                        loadPixel(src_row + o[i * 4 + 3]));
+            y[i] = luma4SSE(px, coef);
+        }
+        storeGlyphs16SSE(_mm_packus_epi32(y[0], y[1]), _mm_packus_epi32(y[2], y[3]),
+                         table, out + x);
+    }
+    lumaRowScalar(src_row, col_offsets + x, count - x, 0, blue_first, table, out + x);
+}
+
+// Gray levels of 16 cells as 16-bit lanes in cell order.
+__attribute__((target("avx2")))
+static inline __m256i luma16AVX2(const uint8_t* src_row, const int* o, __m256i coef) {
+    const __m256i zero = _mm256_setzero_si256();
+    const int* base = reinterpret_cast<const int*>(src_row);
+    __m256i y[2];
+    for (int i = 0; i < 2; i++) {
+        __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(o + i * 8));
+        __m256i px = _mm256_i32gather_epi32(base, idx, 1);
+        __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(px, zero), coef);
+        __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(px, zero), coef);
+        y[i] = _mm256_srli_epi32(_mm256_hadd_epi32(lo, hi), 15);
+    }
+    return _mm256_permute4x64_epi64(_mm256_packus_epi32(y[0], y[1]), 0xD8);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i glyphIndexAVX2(__m256i gray16, __m256i scale) {
+    __m256i x = _mm256_mullo_epi16(gray16, scale);
+    x = _mm256_add_epi16(x, _mm256_add_epi16(_mm256_srli_epi16(x, 8), _mm256_set1_epi16(1)));
+    return _mm256_srli_epi16(x, 8);
+}
+
+__attribute__((target("avx2")))
+static void lumaRowAVX2(const uint8_t* src_row, const int* col_offsets,
+                        int count, int vector_count, bool blue_first,
+                        const GlyphTable& table, char* out) {
+    const __m256i coef = _mm256_broadcastsi128_si256(lumaCoefSSE(blue_first));
+    int x = 0;
+    if (table.palette_size > 0 && table.palette_size <= 16) {
+        __m256i scale = _mm256_set1_epi16(static_cast<short>(table.palette_size - 1));
+        __m256i palette = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.palette)));
+        for (; x + 32 <= vector_count; x += 32) {
+            __m256i i0 = glyphIndexAVX2(luma16AVX2(src_row, col_offsets + x, coef), scale);
+            __m256i i1 = glyphIndexAVX2(luma16AVX2(src_row, col_offsets + x + 16, coef), scale);
+            __m256i idx = _mm256_permute4x64_epi64(_mm256_packus_epi16(i0, i1), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x),
+                                _mm256_shuffle_epi8(palette, idx));
+        }
+    }
+    for (; x + 16 <= vector_count; x += 16) {
+        __m256i gray = luma16AVX2(src_row, col_offsets + x, coef);
+        storeGlyphs16SSE(_mm256_castsi256_si128(gray), _mm256_extracti128_si256(gray, 1),
+                         table, out + x);
+    }
+    lumaRowScalar(src_row, col_offsets + x, count - x, 0, blue_first, table, out + x);
+}
+
+__attribute__((target("sse4.1")))
+static void accumulateRowSSE41(const uint8_t* src, uint16_t* acc, int count) {
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i* a = reinterpret_cast<__m128i*>(acc + i);
+        _mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a), _mm_cvtepu8_epi16(bytes)));
+        _mm_storeu_si128(a + 1, _mm_add_epi16(_mm_loadu_si128(a + 1),
+                                              _mm_cvtepu8_epi16(_mm_srli_si128(bytes, 8))));
+    }
+    accumulateRowScalar(src + i, acc + i, count - i);
+}
+
+__attribute__((target("avx2")))
+static void accumulateRowAVX2(const uint8_t* src, uint16_t* acc, int count) {
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16));
+        __m256i* a = reinterpret_cast<__m256i*>(acc + i);
+        _mm256_storeu_si256(a, _mm256_add_epi16(_mm256_loadu_si256(a), _mm256_cvtepu8_epi16(lo)));
+        _mm256_storeu_si256(a + 1, _mm256_add_epi16(_mm256_loadu_si256(a + 1), _mm256_cvtepu8_epi16(hi)));
+    }
+    accumulateRowScalar(src + i, acc + i, count - i);
+}
+
+__attribute__((target("sse4.1")))
+static int scanBytesSSE41(const uint8_t* a, const uint8_t* b, int begin, int count, bool find_different) {
+    const unsigned flip = find_different ? 0xFFFFu : 0u;
+    int i = begin;
+    for (; i + 16 <= count; i += 16) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        unsigned hits = static_cast<unsigned>(_mm_movemask_epi8(eq)) ^ flip;
+        if (hits) {
+            return i + __builtin_ctz(hits);
+        }
+    }
+    return scanBytesScalar(a, b, i, count, find_different);
+}
+
+__attribute__((target("avx2")))
+static int scanBytesAVX2(const uint8_t* a, const uint8_t* b, int begin, int count, bool find_different) {
+    const unsigned flip = find_different ? 0xFFFFFFFFu : 0u;
+    int i = begin;
+    for (; i + 32 <= count; i += 32) {
+        __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        unsigned hits = static_cast<unsigned>(_mm256_movemask_epi8(eq)) ^ flip;
+        if (hits) {
+            return i + __builtin_ctz(hits);
+        }
+    }
+    return scanBytesSSE41(a, b, i, count, find_different);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i load8SSE(const uint8_t* p) {
+    return _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+}
+
+// Interior columns eight at a time; the ends go through sobelAt.
+__attribute__((target("sse4.1")))
+static void sobelRowSSE41(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+                          int count, int16_t* gx, int16_t* gy) {
+    if (count < 3) {
+        sobelRowScalar(above, row, below, count, gx, gy);
+        return;
+    }
+    sobelAt(above, row, below, 0, 0, 1, gx, gy);
+    int x = 1;
+    for (; x + 9 <= count; x += 8) {
+        __m128i al = load8SSE(above + x - 1), ac = load8SSE(above + x), ar = load8SSE(above + x + 1);
+        __m128i rl = load8SSE(row + x - 1), rr = load8SSE(row + x + 1);
+        __m128i bl = load8SSE(below + x - 1), bc = load8SSE(below + x), br = load8SSE(below + x + 1);
+        __m128i right = _mm_add_epi16(_mm_add_epi16(ar, br), _mm_slli_epi16(rr, 1));
+        __m128i left = _mm_add_epi16(_mm_add_epi16(al, bl), _mm_slli_epi16(rl, 1));
+        __m128i down = _mm_add_epi16(_mm_add_epi16(bl, br), _mm_slli_epi16(bc, 1));
+        __m128i up = _mm_add_epi16(_mm_add_epi16(al, ar), _mm_slli_epi16(ac, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gx + x), _mm_sub_epi16(right, left));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gy + x), _mm_sub_epi16(down, up));
+    }
+    for (; x < count; x++) {
+        sobelAt(above, row, below, x - 1, x, std::min(x + 1, count - 1), gx, gy);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load16AVX2(const uint8_t* p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+__attribute__((target("avx2")))
+static void sobelRowAVX2(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+                         int count, int16_t* gx, int16_t* gy) {
+    if (count < 3) {
+        sobelRowScalar(above, row, below, count, gx, gy);
+        return;
+    }
+    sobelAt(above, row, below, 0, 0, 1, gx, gy);
+    int x = 1;
+    for (; x + 17 <= count; x += 16) {
+        __m256i al = load16AVX2(above + x - 1), ac = load16AVX2(above + x), ar = load16AVX2(above + x + 1);
+        __m256i rl = load16AVX2(row + x - 1), rr = load16AVX2(row + x + 1);
+        __m256i bl = load16AVX2(below + x - 1), bc = load16AVX2(below + x), br = load16AVX2(below + x + 1);
+        __m256i right = _mm256_add_epi16(_mm256_add_epi16(ar, br), _mm256_slli_epi16(rr, 1));
+        __m256i left = _mm256_add_epi16(_mm256_add_epi16(al, bl), _mm256_slli_epi16(rl, 1));
+        __m256i down = _mm256_add_epi16(_mm256_add_epi16(bl, br), _mm256_slli_epi16(bc, 1));
+        __m256i up = _mm256_add_epi16(_mm256_add_epi16(al, ar), _mm256_slli_epi16(ac, 1));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gx + x), _mm256_sub_epi16(right, left));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(gy + x), _mm256_sub_epi16(down, up));
+    }
+    for (; x < count; x++) {
+        sobelAt(above, row, below, x - 1, x, std::min(x + 1, count - 1), gx, gy);
+    }
+}
+
+// x > threshold as x == max(x, threshold + 1), since SSE only compares signed bytes.
+__attribute__((target("sse4.1")))
+static void thresholdBitsSSE41(const uint8_t* src, int count, uint8_t threshold, uint8_t* bits) {
+    int i = 0;
+    if (threshold < 255) {
+        const __m128i limit = _mm_set1_epi8(static_cast<char>(threshold + 1));
+        for (; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            uint16_t mask = static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, limit), v)));
+            memcpy(bits + i / 8, &mask, sizeof(mask));
+        }
+    }
+    thresholdBitsScalar(src + i, count - i, threshold, bits + i / 8);
+}
+
+__attribute__((target("avx2")))
+static void thresholdBitsAVX2(const uint8_t* src, int count, uint8_t threshold, uint8_t* bits) {
+    int i = 0;
+    if (threshold < 255) {
+        const __m256i limit = _mm256_set1_epi8(static_cast<char>(threshold + 1));
+        for (; i + 32 <= count; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            uint32_t mask = static_cast<uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, limit), v)));
+            memcpy(bits + i / 8, &mask, sizeof(mask));
+        }
+    }
+    thresholdBitsSSE41(src + i, count - i, threshold, bits + i / 8);
+}
+
+// x / 255 as (x + 1 + (x >> 8)) >> 8, exact and overflow-free in 16 bits
+// since x stays below 255 * 256.
+__attribute__((target("sse4.1")))
+static void ditherRowSSE41(const uint8_t* gray, const uint8_t* bias, int count, int levels, uint8_t* index) {
+    const __m128i scale = _mm_set1_epi16(static_cast<short>(levels));
+    const __m128i one = _mm_set1_epi16(1);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_add_epi16(_mm_mullo_epi16(load8SSE(gray + i), scale), load8SSE(bias + i));
+        x = _mm_srli_epi16(_mm_add_epi16(x, _mm_add_epi16(_mm_srli_epi16(x, 8), one)), 8);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(index + i), _mm_packus_epi16(x, x));
+    }
+    ditherRowScalar(gray + i, bias + i, count - i, levels, index + i);
+}
+
+__attribute__((target("avx2")))
+static void ditherRowAVX2(const uint8_t* gray, const uint8_t* bias, int count, int levels, uint8_t* index) {
+    const __m256i scale = _mm256_set1_epi16(static_cast<short>(levels));
+    const __m256i one = _mm256_set1_epi16(1);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_add_epi16(_mm256_mullo_epi16(load16AVX2(gray + i), scale), load16AVX2(bias + i));
+        x = _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_add_epi16(_mm256_srli_epi16(x, 8), one)), 8);
+        __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(index + i), packed);
+    }
+    ditherRowSSE41(gray + i, bias + i, count - i, levels, index + i);
+}
+
+// Builds eight 15-bit keys per step and gathers their lut bytes as dwords.
+__attribute__((target("avx2")))
+static void rgb555LookupAVX2(const uint8_t* r, const uint8_t* g, const uint8_t* b, int count,
+                             const uint8_t* lut, uint8_t* out) {
+    const __m256i mask = _mm256_set1_epi32(0xF8);
+    const __m256i low_byte = _mm256_set1_epi32(0xFF);
+    const __m256i compact = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                             0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const int* base = reinterpret_cast<const int*>(lut);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i rr = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(r + i))), mask);
+        __m256i gg = _mm256_and_si256(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(g + i))), mask);
+        __m256i bb = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b + i)));
+        __m256i key = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(rr, 7), _mm256_slli_epi32(gg, 2)),
+                                      _mm256_srli_epi32(bb, 3));
+        __m256i v = _mm256_and_si256(_mm256_i32gather_epi32(base, key, 1), low_byte);
+        v = _mm256_shuffle_epi8(v, compact);
+        uint32_t lo = static_cast<uint32_t>(_mm256_extract_epi32(v, 0));
+        uint32_t hi = static_cast<uint32_t>(_mm256_extract_epi32(v, 4));
+        memcpy(out + i, &lo, sizeof(lo));
+        memcpy(out + i + 4, &hi, sizeof(hi));
+    }
+    rgb555LookupScalar(r + i, g + i, b + i, count - i, lut, out + i);
+}
+
+#endif
+
+bool kernelIsaSupported(KernelIsa isa) {
+    switch (isa) {
+    case KernelIsa::Scalar:
+        return true;
+#ifdef ASCII_KERNELS_X86
+    case KernelIsa::SSE41:
+        return __builtin_cpu_supports("sse4.1");
+    case KernelIsa::AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+KernelIsa bestKernelIsa() {
+    static const KernelIsa best = [] {
+        if (kernelIsaSupported(KernelIsa::AVX2)) {
+            return KernelIsa::AVX2;
+        }
+        if (kernelIsaSupported(KernelIsa::SSE41)) {
+            return KernelIsa::SSE41;
+        }
+        return KernelIsa::Scalar;
+    }();
+    return best;
+}
+
+const char* kernelIsaName(KernelIsa isa) {
+    switch (isa) {
+    case KernelIsa::SSE41:
+        return "sse4.1";
+    case KernelIsa::AVX2:
+        return "avx2";
+    default:
+        return "scalar";
+    }
+}
+
+bool kernelIsaFromName(const std::string& name, KernelIsa& isa) {
+    for (KernelIsa candidate : {KernelIsa::Scalar, KernelIsa::SSE41, KernelIsa::AVX2}) {
+        if (name == kernelIsaName(candidate)) {
+            isa = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+LumaRowKernel lumaRowKernel(KernelIsa isa) {
+    if (!kernelIsaSupported(isa)) {
+        return nullptr;
+    }
+    switch (isa) {
+#ifdef ASCII_KERNELS_X86
+    case KernelIsa::SSE41:
+        return lumaRowSSE41;
+    case KernelIsa::AVX2:
+        return lumaRowAVX2;
+#endif
+    default:
+        return lumaRowScalar;
+    }
+}
+
+AccumulateRowKernel accumulateRowKernel(KernelIsa isa) {
+    if (!kernelIsaSupported(isa)) {
+        return nullptr;
+    }
+    switch (isa) {
+#ifdef ASCII_KERNELS_X86
+    case KernelIsa::SSE41:
+        return accumulateRowSSE41;
+    case KernelIsa::AVX2:
+        return accumulateRowAVX2;
+#endif
+    default:
+        return accumulateRowScalar;
+    }
+}
+
+ScanBytesKernel scanBytesKernel(KernelIsa isa) {
+    if (!kernelIsaSupported(isa)) {
+        return nullptr;
+    }
+    switch (isa) {
+#ifdef ASCII_KERNELS_X86
+    case KernelIsa::SSE41:
+        return scanBytesSSE41;
+    case KernelIsa::AVX2:
+        return scanBytesAVX2;
+#endif
+    default:
+        return scanBytesScalar;
+    }
+}
+
+SobelRowKernel sobelRowKernel(KernelIsa isa) {
+    if (!kernelIsaSupported(isa)) {
+        return nullptr;
+    }
+    switch (isa) {
+#ifdef ASCII_KERNELS_X86
+    case KernelIsa::SSE41:
+        return sobelRowSSE41;
+    case KernelIsa::AVX2:
+        return sobelRowAVX2;
+#endif
+    default:
+        return sobelRowScalar;
+    }
+}
+
+ThresholdBitsKernel thresholdBitsKernel(KernelIsa isa) {
+    if (!kernelIsaSupported(isa)) {
+        return nullptr;
+    }
+    switch (isa) {
+#ifdef ASCII_KERNELS_X86
+    case KernelIsa::SSE41:
+        return thresholdBitsSSE41;
+    case KernelIsa::AVX2:
+        return thresholdBitsAVX2;
+#endif
+    default:
+        return thresholdBitsScalar;
+    }
+}
+
+DitherRowKernel ditherRowKernel(KernelIsa isa) {
+    if (!kernelIsaSupported(isa)) {
+        return nullptr;
+    }
+    switch (isa) {
+#ifdef ASCII_KERNELS_X86
+    case KernelIsa::SSE41:
+        return ditherRowSSE41;
+    case KernelIsa::AVX2:
+        return ditherRowAVX2;
+#endif
+    default:
+        return ditherRowScalar;
+    }
+}
+
+Rgb555LookupKernel rgb555LookupKernel(KernelIsa isa) {
+    if (!kernelIsaSupported(isa)) {
+        return nullptr;
+    }
+    switch (isa) {
+#ifdef ASCII_KERNELS_X86
+    case KernelIsa::AVX2:
+        return rgb555LookupAVX2;
+#endif
+    default:
+        return rgb555LookupScalar;
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Fixed-point BT.601 luma, weights sum to 1 << 15 so white stays 255.
+inline uint8_t lumaFixed(uint8_t r, uint8_t g, uint8_t b) {
+    return static_cast<uint8_t>((r * 9798 + g * 19235 + b * 3735) >> 15);
+}
+
+struct GlyphTable {
+    char lut[256];       // gray level -> glyph
+    char palette[16];    // glyph by index, used by the shuffle kernels
+    int palette_size;
+};
+
+void buildGlyphTable(GlyphTable& table, const std::string& ascii_chars);
+
+enum class KernelIsa {
+    Scalar,
+    SSE41,
+    AVX2
+};
+
+// Converts one output row of packed RGB (or BGR when blue_first is set; a
+// fourth byte per pixel is ignored). col_offsets are byte offsets of the
+// sampled pixel inside src_row. Only the first vector_count cells may be read
+// with 4-byte loads; the rest are converted one pixel at a time.
+using LumaRowKernel = void (*)(const uint8_t* src_row, const int* col_offsets,
+                               int count, int vector_count, bool blue_first,
+                               const GlyphTable& table, char* out);
+
+bool kernelIsaSupported(KernelIsa isa);
+KernelIsa bestKernelIsa();
+const char* kernelIsaName(KernelIsa isa);
+// Inverse of kernelIsaName; returns false for an unknown name.
+bool kernelIsaFromName(const std::string& name, KernelIsa& isa);
+LumaRowKernel lumaRowKernel(KernelIsa isa);
+
+// Adds count bytes of src into the 16-bit accumulators in acc. Callers must
+// flush before 258 rows have been added to avoid overflow.
+using AccumulateRowKernel = void (*)(const uint8_t* src, uint16_t* acc, int count);
+
+AccumulateRowKernel accumulateRowKernel(KernelIsa isa);
+
+// Returns the first i in [begin, count) where a[i] != b[i] (find_different)
+// or a[i] == b[i] (otherwise), or count when there is none.
+using ScanBytesKernel = int (*)(const uint8_t* a, const uint8_t* b, int begin, int count, bool find_different);
+
+ScanBytesKernel scanBytesKernel(KernelIsa isa);
+
+// 3x3 Sobel gradients of the middle of three rows of count samples, with
+// the outermost columns replicated at either end.
+using SobelRowKernel = void (*)(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+                                int count, int16_t* gx, int16_t* gy);
+
+SobelRowKernel sobelRowKernel(KernelIsa isa);
+
+// Sets bit i of bits (LSB first, (count + 7) / 8 bytes) when src[i] > threshold.
+using ThresholdBitsKernel = void (*)(const uint8_t* src, int count, uint8_t threshold, uint8_t* bits);
+
+ThresholdBitsKernel thresholdBitsKernel(KernelIsa isa);
+
+// Ordered dithering: index[i] = (gray[i] * levels + bias[i]) / 255, with
+// levels the palette size minus one and bias a threshold in [0, 255).
+using DitherRowKernel = void (*)(const uint8_t* gray, const uint8_t* bias, int count, int levels, uint8_t* index);
+
+DitherRowKernel ditherRowKernel(KernelIsa isa);
+
+// out[i] = lut[(r[i] >> 3) << 10 | (g[i] >> 3) << 5 | b[i] >> 3]. The lut must
+// have 3 readable bytes past its 32768 entries for the gather kernels.
+using Rgb555LookupKernel = void (*)(const uint8_t* r, const uint8_t* g, const uint8_t* b, int count,
+                                    const uint8_t* lut, uint8_t* out);
+
+Rgb555LookupKernel rgb555LookupKernel(KernelIsa isa);
@@ -1,4 +1,5 @@
 #include "gl_text_renderer.h"
+#include "glyph_bitmaps.h"
 #include <iostream>
 #include <cstring>
 
@@ -38,102 +39,12 @@ bool GLTextRenderer::initialize() {
 }
 
 void GLTextRenderer::createCharacterTextures() {
-    const int font_width = 8;
-    const int font_height = 12;
+    const int font_width = kGlyphWidth;
+    const int font_height = kGlyphHeight;
 
     for (int c = 32; c < 127; c++) {
         unsigned char bitmap[font_width * font_height];
-        memset(bitmap, 0, sizeof(bitmap));
-
-        if (c == ' ') {
-            for (int i = 0; i < font_width * font_height; i++) {
-                bitmap[i] = 0;
-            }
-        }
-        else if (c == '.') {
-            bitmap[(font_height-2) * font_width + 3] = 255;
-            bitmap[(font_height-2) * font_width + 4] = 255;
-        }
-        else if (c == ':') {
-            bitmap[4 * font_width + 3] = 255;
-            bitmap[4 * font_width + 4] = 255;
-            bitmap[8 * font_width + 3] = 255;
-            bitmap[8 * font_width + 4] = 255;
-        }
-        else if (c == '-') {
-            for (int x = 1; x < 7; x++) {
-                bitmap[6 * font_width + x] = 255;
-            }
-        }
-        else if (c == '=') {
-            for (int x = 1; x < 7; x++) {
-                bitmap[5 * font_width + x] = 255;
-                bitmap[7 * font_width + x] = 255;
-            }
-        }
-        else if (c == '+') {
-            for (int x = 1; x < 7; x++) {
-                bitmap[6 * font_width + x] = 255;
-            }
-            for (int y = 3; y < 10; y++) {
-                bitmap[y * font_width + 4] = 255;
-            }
-        }
-        else if (c == '*') {
-            bitmap[4 * font_width + 4] = 255;
-            bitmap[5 * font_width + 2] = 255;
-            bitmap[5 * font_width + 4] = 255;
-            bitmap[5 * font_width + 6] = 255;
-            bitmap[6 * font_width + 1] = 255;
-            bitmap[6 * font_width + 4] = 255;
-            bitmap[6 * font_width + 7] = 255;
-            bitmap[7 * font_width + 2] = 255;
-            bitmap[7 * font_width + 4] = 255;
-            bitmap[7 * font_width + 6] = 255;
-            bitmap[8 * font_width + 4] = 255;
-        }
-        else if (c == '#') {
-            for (int y = 2; y < 10; y++) {
-                bitmap[y * font_width + 2] = 255;
-                bitmap[y * font_width + 5] = 255;
-            }
-            for (int x = 1; x < 7; x++) {
-                bitmap[4 * font_width + x] = 255;
-                bitmap[7 * font_width + x] = 255;
-            }
-        }
-        else if (c == '%') {
-            bitmap[2 * font_width + 1] = 255;
-            bitmap[2 * font_width + 2] = 255;
-            bitmap[3 * font_width + 1] = 255;
-            bitmap[3 * font_width + 2] = 255;
-            bitmap[3 * font_width + 4] = 255;
-            bitmap[4 * font_width + 3] = 255;
-            bitmap[5 * font_width + 3] = 255;
-            bitmap[6 * font_width + 2] = 255;
-            bitmap[7 * font_width + 4] = 255;
-            bitmap[8 * font_width + 5] = 255;
-            bitmap[8 * font_width + 6] = 255;
-            bitmap[9 * font_width + 5] = 255;
-            bitmap[9 * font_width + 6] = 255;
-        }
-        else if (c == '@') {
-            for (int y = 2; y < 10; y++) {
-                for (int x = 1; x < 7; x++) {
-                    if ((y == 2 || y == 9) && (x > 1 && x < 6)) bitmap[y * font_width + x] = 255;
-                    else if ((x == 1 || x == 6) && (y > 2 && y < 9)) bitmap[y * font_width + x] = 255;
-                    else if (y == 5 && x > 2 && x < 6) bitmap[y * font_width + x] = 255;
-                    else if (x == 4 && y > 5 && y < 8) bitmap[y * font_width + x] = 255;
-                }
-            }
-        }
-        else {
-            for (int y = 0; y < font_height; y++) {
-                for (int x = 0; x < font_width; x++) {
-                    bitmap[y * font_width + x] = ((x + y) % 2) ? 255 : 0;
-                }
-            }
-        }
+        rasterizeGlyph(static_cast<char>(c), bitmap);
 
         unsigned int texture;
         glGenTextures(1, &texture);
@@ -152,7 +63,7 @@ void GLTextRenderer::createCharacterTextures() {
     }
 }
 
-void GLTextRenderer::renderText(const std::string& text, float x, float y, float scale) {
+void GLTextRenderer::renderText(std::string_view text, float x, float y, float scale) {
     float current_x = x;
     float current_y = y;
 
@@ -171,6 +82,42 @@ void GLTextRenderer::renderText(const std::string& text, float x, float y, float
     }
 }
 
+void GLTextRenderer::renderGlyphIndices(const GlyphIndexFrame& frame, const std::string& palette,
+                                        float x, float y, float scale) {
+    for (int row = 0; row < frame.height; row++) {
+        float current_y = y + row * char_height_ * scale;
+        for (int col = 0; col < frame.width; col++) {
+            uint8_t index = frame.index(col, row);
+            if (index < palette.size()) {
+                renderCharacter(palette[index], x + col * char_width_ * scale, current_y, scale);
+            }
+        }
+    }
+}
+
+void GLTextRenderer::renderColorFrame(const ColorAsciiFrame& frame, const std::string& palette,
+                                      float x, float y, float scale) {
+    const float saved_r = color_r_, saved_g = color_g_, saved_b = color_b_;
+    for (int row = 0; row < frame.height; row++) {
+        float current_y = y + row * char_height_ * scale;
+        size_t offset = static_cast<size_t>(row) * frame.width;
+        for (int col = 0; col < frame.width; col++) {
+            size_t cell = offset + col;
+            uint8_t index = frame.glyphs.data()[cell];
+            if (index >= palette.size()) {
+                continue;
+            }
+            color_r_ = frame.red.data()[cell] / 255.0f;
+            color_g_ = frame.green.data()[cell] / 255.0f;
+            color_b_ = frame.blue.data()[cell] / 255.0f;
+            renderCharacter(palette[index], x + col * char_width_ * scale, current_y, scale);
+        }
+    }
+    color_r_ = saved_r;
+    color_g_ = saved_g;
+    color_b_ = saved_b;
+}
+
 void GLTextRenderer::renderCharacter(char c, float x, float y, float scale) {
     if (c < 0 || c >= 256 || characters_[c].texture_id == 0) {
         return;
@@ -2,7 +2,9 @@
 
 #include <GLFW/glfw3.h>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "ascii_frame.h"
 
 class GLTextRenderer {
 public:
@@ -10,7 +12,9 @@ public:
     ~GLTextRenderer();
 
     bool initialize();
-    void renderText(const std::string& text, float x, float y, float scale = 1.0f);
+    void renderText(std::string_view text, float x, float y, float scale = 1.0f);
+    void renderGlyphIndices(const GlyphIndexFrame& frame, const std::string& palette, float x, float y, float scale = 1.0f);
+    void renderColorFrame(const ColorAsciiFrame& frame, const std::string& palette, float x, float y, float scale = 1.0f);
     void clear();
     void setColor(float r, float g, float b, float a = 1.0f);
     void setCharSize(float width, float height);
@@ -0,0 +1,130 @@
+#include "glyph_bitmaps.h"
+#include <cstring>
+
+void rasterizeGlyph(char c, uint8_t* bitmap) {
+    const int font_width = kGlyphWidth;
+    const int font_height = kGlyphHeight;
+    memset(bitmap, 0, font_width * font_height);
+
+    if (c == ' ') {
+        for (int i = 0; i < font_width * font_height; i++) {
+            bitmap[i] = 0;
+        }
+    }
+    else if (c == '.') {
+        bitmap[(font_height-2) * font_width + 3] = 255;
+        bitmap[(font_height-2) * font_width + 4] = 255;
+    }
+    else if (c == ':') {
+        bitmap[4 * font_width + 3] = 255;
+        bitmap[4 * font_width + 4] = 255;
+        bitmap[8 * font_width + 3] = 255;
+        bitmap[8 * font_width + 4] = 255;
+    }
+    else if (c == '-') {
+        for (int x = 1; x < 7; x++) {
+            bitmap[6 * font_width + x] = 255;
+        }
+    }
+    else if (c == '=') {
+        for (int x = 1; x < 7; x++) {
+            bitmap[5 * font_width + x] = 255;
+            bitmap[7 * font_width + x] = 255;
+        }
+    }
+    else if (c == '+') {
+        for (int x = 1; x < 7; x++) {
+            bitmap[6 * font_width + x] = 255;
+        }
+        for (int y = 3; y < 10; y++) {
+            bitmap[y * font_width + 4] = 255;
+        }
+    }
+    else if (c == '*') {
+        bitmap[4 * font_width + 4] = 255;
+        bitmap[5 * font_width + 2] = 255;
+        bitmap[5 * font_width + 4] = 255;
+        bitmap[5 * font_width + 6] = 255;
+        bitmap[6 * font_width + 1] = 255;
+        bitmap[6 * font_width + 4] = 255;
+        bitmap[6 * font_width + 7] = 255;
+        bitmap[7 * font_width + 2] = 255;
+        bitmap[7 * font_width + 4] = 255;
+        bitmap[7 * font_width + 6] = 255;
+        bitmap[8 * font_width + 4] = 255;
+    }
+    else if (c == '#') {
+        for (int y = 2; y < 10; y++) {
+            bitmap[y * font_width + 2] = 255;
+            bitmap[y * font_width + 5] = 255;
+        }
+        for (int x = 1; x < 7; x++) {
+            bitmap[4 * font_width + x] = 255;
+            bitmap[7 * font_width + x] = 255;
+        }
+    }
+    else if (c == '%') {
+        bitmap[2 * font_width + 1] = 255;
+        bitmap[2 * font_width + 2] = 255;
+        bitmap[3 * font_width + 1] = 255;
+        bitmap[3 * font_width + 2] = 255;
+        bitmap[3 * font_width + 4] = 255;
+        bitmap[4 * font_width + 3] = 255;
+        bitmap[5 * font_width + 3] = 255;
+        bitmap[6 * font_width + 2] = 255;
+        bitmap[7 * font_width + 4] = 255;
+        bitmap[8 * font_width + 5] = 255;
+        bitmap[8 * font_width + 6] = 255;
+        bitmap[9 * font_width + 5] = 255;
+        bitmap[9 * font_width + 6] = 255;
+    }
+    else if (c == '@') {
+        for (int y = 2; y < 10; y++) {
+            for (int x = 1; x < 7; x++) {
+                if ((y == 2 || y == 9) && (x > 1 && x < 6)) bitmap[y * font_width + x] = 255;
+                else if ((x == 1 || x == 6) && (y > 2 && y < 9)) bitmap[y * font_width + x] = 255;
+                else if (y == 5 && x > 2 && x < 6) bitmap[y * font_width + x] = 255;
+                else if (x == 4 && y > 5 && y < 8) bitmap[y * font_width + x] = 255;
+            }
+        }
+    }
+    else if (c == '|') {
+        for (int y = 1; y < 11; y++) {
+            bitmap[y * font_width + 3] = 255;
+            bitmap[y * font_width + 4] = 255;
+        }
+    }
+    else if (c == '/' || c == '\\') {
+        for (int y = 1; y < 11; y++) {
+            int x = 7 - (y - 1) * 7 / 9;
+            if (c == '\\') x = 7 - x;
+            bitmap[y * font_width + x] = 255;
+        }
+    }
+    else {
+        for (int y = 0; y < font_height; y++) {
+            for (int x = 0; x < font_width; x++) {
+                bitmap[y * font_width + x] = ((x + y) % 2) ? 255 : 0;
+            }
+        }
+    }
+}
+
+GlyphMask glyphMask(char c) {
+    uint8_t bitmap[kGlyphWidth * kGlyphHeight];
+    rasterizeGlyph(c, bitmap);
+
+    GlyphMask mask = {0, 0};
+    for (int y = 0; y < kGlyphHeight; y++) {
+        uint64_t row = 0;
+        for (int x = 0; x < kGlyphWidth; x++) {
+            row |= static_cast<uint64_t>(bitmap[y * kGlyphWidth + x] != 0) << x;
+        }
+        if (y < 8) {
+            mask.rows_lo |= row << (y * 8);
+        } else {
+            mask.rows_hi |= static_cast<uint32_t>(row << ((y - 8) * 8));
+        }
+    }
+    return mask;
+}
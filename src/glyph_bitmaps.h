@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// Cell size of the built-in bitmap font.
+constexpr int kGlyphWidth = 8;
+constexpr int kGlyphHeight = 12;
+
+// Draws c into kGlyphWidth * kGlyphHeight bytes, row-major, 255 where the
+// glyph has ink and 0 elsewhere.
+void rasterizeGlyph(char c, uint8_t* bitmap);
+
+// One bit per font pixel: bit x of byte y is pixel (x, y), rows 0-7 in
+// rows_lo and rows 8-11 in rows_hi.
+struct GlyphMask {
+    uint64_t rows_lo;
+    uint32_t rows_hi;
+};
+
+GlyphMask glyphMask(char c);
+
+inline int hammingDistance(GlyphMask a, GlyphMask b) {
+    return __builtin_popcountll(a.rows_lo ^ b.rows_lo) + __builtin_popcount(a.rows_hi ^ b.rows_hi);
+}
+
+// Moves every row of mask one column right (dx = 1) or left (dx = -1),
+// dropping the pixels pushed out of the cell.
+inline GlyphMask shiftColumns(GlyphMask mask, int dx) {
+    if (dx > 0) {
+        return {(mask.rows_lo << 1) & 0xFEFEFEFEFEFEFEFEull, (mask.rows_hi << 1) & 0xFEFEFEFEu};
+    }
+    return {(mask.rows_lo >> 1) & 0x7F7F7F7F7F7F7F7Full, (mask.rows_hi >> 1) & 0x7F7F7F7Fu};
+}
+
+// Hamming distance to the closest of glyph and glyph moved one column either
+// way, so strokes slightly off the cell centre still match their glyph. A
+// shifted match costs one extra pixel, so the unshifted glyph wins ties.
+inline int shiftedHammingDistance(GlyphMask mask, GlyphMask glyph) {
+    const int left = hammingDistance(mask, shiftColumns(glyph, -1));
+    const int right = hammingDistance(mask, shiftColumns(glyph, 1));
+    return std::min(hammingDistance(mask, glyph), std::min(left, right) + 1);
+}
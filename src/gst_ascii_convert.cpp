@@ -0,0 +1,253 @@
+#include "gst_ascii_convert.h"
+#include <gst/video/video.h>
+#include "ascii_converter.h"
+#include "gst_video_format.h"
+
+struct _GstAsciiConvert {
+    GstBaseTransform parent;
+
+    // Properties, read under the object lock.
+    int columns;
+    int rows;
+    gchar* chars;
+    gboolean area;
+    int threads;
+
+    AsciiConverter* converter;
+    AsciiFrame* frame;
+    GstVideoInfo info;
+    PixelFormat format;
+};
+
+enum {
+    PROP_0,
+    PROP_WIDTH,
+    PROP_HEIGHT,
+    PROP_CHARS,
+    PROP_AREA,
+    PROP_THREADS
+};
+
+static const int kDefaultColumns = 128;
+static const int kDefaultRows = 64;
+static const char* kDefaultChars = " .:-=+*#%@";
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
+    "sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE(ASCII_VIDEO_FORMATS)));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
+    "src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS(ASCII_TEXT_CAPS));
+
+G_DEFINE_TYPE(GstAsciiConvert, gst_ascii_convert, GST_TYPE_BASE_TRANSFORM)
+
+static void gst_ascii_convert_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec) {
+    GstAsciiConvert* self = GST_ASCII_CONVERT(object);
+
+    // Grid size changes take effect through renegotiation; the rest apply
+    // from the next frame.
+    GST_OBJECT_LOCK(self);
+    switch (prop_id) {
+    case PROP_WIDTH:
+        self->columns = g_value_get_int(value);
+        break;
+    case PROP_HEIGHT:
+        self->rows = g_value_get_int(value);
+        break;
+    case PROP_CHARS:
+        g_free(self->chars);
+        self->chars = g_value_dup_string(value);
+        self->converter->setAsciiChars(self->chars ? self->chars : kDefaultChars);
+        break;
+    case PROP_AREA:
+        self->area = g_value_get_boolean(value);
+        self->converter->setSamplingMode(self->area ? SamplingMode::Area : SamplingMode::Nearest);
+        break;
+    case PROP_THREADS:
+        self->threads = g_value_get_int(value);
+        self->converter->setThreadCount(self->threads);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+
+    if (prop_id == PROP_WIDTH || prop_id == PROP_HEIGHT) {
+        gst_pad_mark_reconfigure(GST_BASE_TRANSFORM_SRC_PAD(self));
+    }
+}
+
+static void gst_ascii_convert_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec) {
+    GstAsciiConvert* self = GST_ASCII_CONVERT(object);
+
+    GST_OBJECT_LOCK(self);
+    switch (prop_id) {
+    case PROP_WIDTH:
+        g_value_set_int(value, self->columns);
+        break;
+    case PROP_HEIGHT:
+        g_value_set_int(value, self->rows);
+        break;
+    case PROP_CHARS:
+        g_value_set_string(value, self->chars);
+        break;
+    case PROP_AREA:
+        g_value_set_boolean(value, self->area);
+        break;
+    case PROP_THREADS:
+        g_value_set_int(value, self->threads);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+    GST_OBJECT_UNLOCK(self);
+}
+
+static void gst_ascii_convert_finalize(GObject* object) {
+    GstAsciiConvert* self = GST_ASCII_CONVERT(object);
+    delete self->frame;
+    delete self->converter;
+    g_free(self->chars);
+    G_OBJECT_CLASS(gst_ascii_convert_parent_class)->finalize(object);
+}
+
+// Any video maps to the configured grid and back; the frame rate is kept.
+static GstCaps* gst_ascii_convert_transform_caps(GstBaseTransform* trans, GstPadDirection direction, GstCaps* caps,
+                                                 GstCaps* filter) {
+    GstAsciiConvert* self = GST_ASCII_CONVERT(trans);
+    GST_OBJECT_LOCK(self);
+    const int columns = self->columns;
+    const int rows = self->rows;
+    GST_OBJECT_UNLOCK(self);
+
+    GstCaps* result = gst_caps_new_empty();
+    GstCaps* templ = gst_static_pad_template_get_caps(&sink_template);
+    for (guint i = 0; i < gst_caps_get_size(caps); i++) {
+        const GValue* framerate = gst_structure_get_value(gst_caps_get_structure(caps, i), "framerate");
+        if (direction == GST_PAD_SINK) {
+            GstStructure* text = gst_structure_new("text/x-ascii", "width", G_TYPE_INT, columns,
+                                                   "height", G_TYPE_INT, rows, nullptr);
+            if (framerate) {
+                gst_structure_set_value(text, "framerate", framerate);
+            }
+            result = gst_caps_merge_structure(result, text);
+        } else {
+            for (guint j = 0; j < gst_caps_get_size(templ); j++) {
+                GstStructure* video = gst_structure_copy(gst_caps_get_structure(templ, j));
+                if (framerate) {
+                    gst_structure_set_value(video, "framerate", framerate);
+                }
+                result = gst_caps_merge_structure(result, video);
+            }
+        }
+    }
+    gst_caps_unref(templ);
+
+    if (filter) {
+        GstCaps* filtered = gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref(result);
+        result = filtered;
+    }
+    return result;
+}
+
+static gboolean gst_ascii_convert_set_caps(GstBaseTransform* trans, GstCaps* incaps, GstCaps* outcaps) {
+    GstAsciiConvert* self = GST_ASCII_CONVERT(trans);
+    int columns;
+    int rows;
+    if (!gst_video_info_from_caps(&self->info, incaps) ||
+        !toPixelFormat(GST_VIDEO_INFO_FORMAT(&self->info), &self->format) ||
+        !gst_structure_get_int(gst_caps_get_structure(outcaps, 0), "width", &columns) ||
+        !gst_structure_get_int(gst_caps_get_structure(outcaps, 0), "height", &rows)) {
+        return FALSE;
+    }
+    self->converter->setOutputSize(columns, rows);
+    return TRUE;
+}
+
+// One grid per frame either way, so the size on the other pad follows from
+// its caps alone.
+static gboolean gst_ascii_convert_transform_size(GstBaseTransform* trans, GstPadDirection direction, GstCaps* caps,
+                                                 gsize size, GstCaps* othercaps, gsize* othersize) {
+    if (direction == GST_PAD_SRC) {
+        GstVideoInfo info;
+        if (!gst_video_info_from_caps(&info, othercaps)) {
+            return FALSE;
+        }
+        *othersize = GST_VIDEO_INFO_SIZE(&info);
+        return TRUE;
+    }
+
+    int columns;
+    int rows;
+    if (!gst_structure_get_int(gst_caps_get_structure(othercaps, 0), "width", &columns) ||
+        !gst_structure_get_int(gst_caps_get_structure(othercaps, 0), "height", &rows)) {
+        return FALSE;
+    }
+    *othersize = static_cast<gsize>(rows) * (columns + 1);
+    return TRUE;
+}
+
+static GstFlowReturn gst_ascii_convert_transform(GstBaseTransform* trans, GstBuffer* inbuf, GstBuffer* outbuf) {
+    GstAsciiConvert* self = GST_ASCII_CONVERT(trans);
+
+    GstVideoFrame video_frame;
+    if (!gst_video_frame_map(&video_frame, &self->info, inbuf, GST_MAP_READ)) {
+        return GST_FLOW_ERROR;
+    }
+    self->converter->convertInto(toVideoFrameView(video_frame, self->format), *self->frame);
+    gst_video_frame_unmap(&video_frame);
+
+    const size_t size = self->frame->text.size();
+    if (gst_buffer_get_size(outbuf) != size) {
+        return GST_FLOW_ERROR;
+    }
+    gst_buffer_fill(outbuf, 0, self->frame->text.data(), size);
+    return GST_FLOW_OK;
+}
+
+static void gst_ascii_convert_class_init(GstAsciiConvertClass* klass) {
+    GObjectClass* gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass* element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseTransformClass* transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+    gobject_class->set_property = gst_ascii_convert_set_property;
+    gobject_class->get_property = gst_ascii_convert_get_property;
+    gobject_class->finalize = gst_ascii_convert_finalize;
+
+    const GParamFlags flags = static_cast<GParamFlags>(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+    g_object_class_install_property(gobject_class, PROP_WIDTH,
+        g_param_spec_int("width", "Width", "Grid columns", 1, 4096, kDefaultColumns, flags));
+    g_object_class_install_property(gobject_class, PROP_HEIGHT,
+        g_param_spec_int("height", "Height", "Grid rows", 1, 4096, kDefaultRows, flags));
+    g_object_class_install_property(gobject_class, PROP_CHARS,
+        g_param_spec_string("chars", "Characters", "Glyph ramp from dark to bright", kDefaultChars, flags));
+    g_object_class_install_property(gobject_class, PROP_AREA,
+        g_param_spec_boolean("area", "Area sampling", "Average every source pixel under a cell", FALSE, flags));
+    g_object_class_install_property(gobject_class, PROP_THREADS,
+        g_param_spec_int("threads", "Threads", "Conversion threads", 1, 64, 1, flags));
+
+    gst_element_class_set_static_metadata(element_class, "ASCII converter", "Filter/Converter/Video",
+                                          "Converts raw video to a grid of ASCII glyphs", "img2ascii");
+    gst_element_class_add_static_pad_template(element_class, &sink_template);
+    gst_element_class_add_static_pad_template(element_class, &src_template);
+
+    transform_class->transform_caps = gst_ascii_convert_transform_caps;
+    transform_class->set_caps = gst_ascii_convert_set_caps;
+    transform_class->transform_size = gst_ascii_convert_transform_size;
+    transform_class->transform = gst_ascii_convert_transform;
+}
+
+static void gst_ascii_convert_init(GstAsciiConvert* self) {
+    self->columns = kDefaultColumns;
+    self->rows = kDefaultRows;
+    self->chars = g_strdup(kDefaultChars);
+    self->area = FALSE;
+    self->threads = 1;
+    self->converter = new AsciiConverter(kDefaultColumns, kDefaultRows);
+    self->frame = new AsciiFrame();
+    gst_video_info_init(&self->info);
+    self->format = PixelFormat::RGB;
+    gst_base_transform_set_qos_enabled(GST_BASE_TRANSFORM(self), TRUE);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <gst/base/gstbasetransform.h>
+
+// Text grids exchanged between asciiconvert and asciirender: height lines of
+// width glyphs, each ending in '\n'.
+#define ASCII_TEXT_CAPS \
+    "text/x-ascii, width = (int) [ 1, 4096 ], height = (int) [ 1, 4096 ], framerate = (fraction) [ 0/1, MAX ]"
+
+G_BEGIN_DECLS
+
+// asciiconvert: raw video in, text/x-ascii grids out, one per frame.
+#define GST_TYPE_ASCII_CONVERT (gst_ascii_convert_get_type())
+G_DECLARE_FINAL_TYPE(GstAsciiConvert, gst_ascii_convert, GST, ASCII_CONVERT, GstBaseTransform)
+
+G_END_DECLS
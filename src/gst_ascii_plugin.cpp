@@ -0,0 +1,15 @@
+#include <gst/gst.h>
+#include "gst_ascii_convert.h"
+#include "gst_ascii_render.h"
+
+#ifndef PACKAGE
+#define PACKAGE "img2ascii"
+#endif
+
+static gboolean plugin_init(GstPlugin* plugin) {
+    return gst_element_register(plugin, "asciiconvert", GST_RANK_NONE, GST_TYPE_ASCII_CONVERT) &&
+           gst_element_register(plugin, "asciirender", GST_RANK_NONE, GST_TYPE_ASCII_RENDER);
+}
+
+GST_PLUGIN_DEFINE(GST_VERSION_MAJOR, GST_VERSION_MINOR, ascii, "ASCII art conversion of raw video",
+                  plugin_init, "1.0", "MIT/X11", "img2ascii", "img2ascii")
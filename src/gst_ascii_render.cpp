@@ -0,0 +1,164 @@
+#include "gst_ascii_render.h"
+#include <gst/video/video.h>
+#include <cstring>
+#include "glyph_bitmaps.h"
+#include "gst_ascii_convert.h"
+
+struct _GstAsciiRender {
+    GstBaseTransform parent;
+
+    int columns;
+    int rows;
+    GstVideoInfo out_info;
+};
+
+static const int kGlyphBytes = kGlyphWidth * kGlyphHeight;
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
+    "sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS(ASCII_TEXT_CAPS));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
+    "src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("GRAY8")));
+
+// Bitmaps of every byte value, drawn once for all instances.
+static uint8_t glyph_bitmaps[256][kGlyphBytes];
+
+G_DEFINE_TYPE(GstAsciiRender, gst_ascii_render, GST_TYPE_BASE_TRANSFORM)
+
+// Scales a fixed size between grid cells and pixels; anything else becomes
+// the full range of the other side.
+static void transformDimension(const GstStructure* in, const char* field, int cell_size, gboolean to_pixels,
+                               GstStructure* out) {
+    int value;
+    if (gst_structure_get_int(in, field, &value)) {
+        if (to_pixels) {
+            gst_structure_set(out, field, G_TYPE_INT, value * cell_size, nullptr);
+            return;
+        }
+        if (value % cell_size == 0) {
+            gst_structure_set(out, field, G_TYPE_INT, value / cell_size, nullptr);
+        }
+        return;
+    }
+    gst_structure_set(out, field, GST_TYPE_INT_RANGE, to_pixels ? cell_size : 1, G_MAXINT, nullptr);
+}
+
+static GstCaps* gst_ascii_render_transform_caps(GstBaseTransform* trans, GstPadDirection direction, GstCaps* caps,
+                                                GstCaps* filter) {
+    const gboolean to_pixels = direction == GST_PAD_SINK;
+    GstCaps* result = gst_caps_new_empty();
+    for (guint i = 0; i < gst_caps_get_size(caps); i++) {
+        const GstStructure* in = gst_caps_get_structure(caps, i);
+        GstStructure* out = to_pixels ? gst_structure_new("video/x-raw", "format", G_TYPE_STRING, "GRAY8", nullptr)
+                                      : gst_structure_new_empty("text/x-ascii");
+        transformDimension(in, "width", kGlyphWidth, to_pixels, out);
+        transformDimension(in, "height", kGlyphHeight, to_pixels, out);
+        if (!gst_structure_has_field(out, "width") || !gst_structure_has_field(out, "height")) {
+            // A video size that is not a whole number of cells.
+            gst_structure_free(out);
+            continue;
+        }
+        if (const GValue* framerate = gst_structure_get_value(in, "framerate")) {
+            gst_structure_set_value(out, "framerate", framerate);
+        }
+        result = gst_caps_merge_structure(result, out);
+    }
+
+    if (filter) {
+        GstCaps* filtered = gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref(result);
+        result = filtered;
+    }
+    return result;
+}
+
+static gboolean gst_ascii_render_set_caps(GstBaseTransform* trans, GstCaps* incaps, GstCaps* outcaps) {
+    GstAsciiRender* self = GST_ASCII_RENDER(trans);
+    const GstStructure* text = gst_caps_get_structure(incaps, 0);
+    return gst_structure_get_int(text, "width", &self->columns) &&
+           gst_structure_get_int(text, "height", &self->rows) &&
+           gst_video_info_from_caps(&self->out_info, outcaps);
+}
+
+// One frame per grid either way, so the size on the other pad follows from
+// its caps alone.
+static gboolean gst_ascii_render_transform_size(GstBaseTransform* trans, GstPadDirection direction, GstCaps* caps,
+                                                gsize size, GstCaps* othercaps, gsize* othersize) {
+    if (direction == GST_PAD_SRC) {
+        int columns;
+        int rows;
+        if (!gst_structure_get_int(gst_caps_get_structure(othercaps, 0), "width", &columns) ||
+            !gst_structure_get_int(gst_caps_get_structure(othercaps, 0), "height", &rows)) {
+            return FALSE;
+        }
+        *othersize = static_cast<gsize>(rows) * (columns + 1);
+        return TRUE;
+    }
+
+    GstVideoInfo info;
+    if (!gst_video_info_from_caps(&info, othercaps)) {
+        return FALSE;
+    }
+    *othersize = GST_VIDEO_INFO_SIZE(&info);
+    return TRUE;
+}
+
+static GstFlowReturn gst_ascii_render_transform(GstBaseTransform* trans, GstBuffer* inbuf, GstBuffer* outbuf) {
+    GstAsciiRender* self = GST_ASCII_RENDER(trans);
+    const size_t line_length = static_cast<size_t>(self->columns) + 1;
+
+    GstMapInfo text;
+    if (!gst_buffer_map(inbuf, &text, GST_MAP_READ)) {
+        return GST_FLOW_ERROR;
+    }
+    if (text.size < line_length * self->rows) {
+        gst_buffer_unmap(inbuf, &text);
+        return GST_FLOW_ERROR;
+    }
+    GstVideoFrame video_frame;
+    if (!gst_video_frame_map(&video_frame, &self->out_info, outbuf, GST_MAP_WRITE)) {
+        gst_buffer_unmap(inbuf, &text);
+        return GST_FLOW_ERROR;
+    }
+
+    uint8_t* pixels = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&video_frame, 0));
+    const int stride = GST_VIDEO_FRAME_PLANE_STRIDE(&video_frame, 0);
+    for (int y = 0; y < self->rows; y++) {
+        const uint8_t* line = text.data + y * line_length;
+        for (int row = 0; row < kGlyphHeight; row++) {
+            uint8_t* dst = pixels + static_cast<size_t>(y * kGlyphHeight + row) * stride;
+            for (int x = 0; x < self->columns; x++) {
+                memcpy(dst + x * kGlyphWidth, glyph_bitmaps[line[x]] + row * kGlyphWidth, kGlyphWidth);
+            }
+        }
+    }
+
+    gst_video_frame_unmap(&video_frame);
+    gst_buffer_unmap(inbuf, &text);
+    return GST_FLOW_OK;
+}
+
+static void gst_ascii_render_class_init(GstAsciiRenderClass* klass) {
+    GstElementClass* element_class = GST_ELEMENT_CLASS(klass);
+    GstBaseTransformClass* transform_class = GST_BASE_TRANSFORM_CLASS(klass);
+
+    for (int c = 0; c < 256; c++) {
+        rasterizeGlyph(static_cast<char>(c), glyph_bitmaps[c]);
+    }
+
+    gst_element_class_set_static_metadata(element_class, "ASCII renderer", "Filter/Converter/Video",
+                                          "Draws ASCII glyph grids as grayscale video", "img2ascii");
+    gst_element_class_add_static_pad_template(element_class, &sink_template);
+    gst_element_class_add_static_pad_template(element_class, &src_template);
+
+    transform_class->transform_caps = gst_ascii_render_transform_caps;
+    transform_class->set_caps = gst_ascii_render_set_caps;
+    transform_class->transform_size = gst_ascii_render_transform_size;
+    transform_class->transform = gst_ascii_render_transform;
+}
+
+static void gst_ascii_render_init(GstAsciiRender* self) {
+    self->columns = 0;
+    self->rows = 0;
+    gst_video_info_init(&self->out_info);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <gst/base/gstbasetransform.h>
+
+G_BEGIN_DECLS
+
+// asciirender: text/x-ascii grids in, GRAY8 video out with every glyph drawn
+// from the built-in kGlyphWidth x kGlyphHeight font.
+#define GST_TYPE_ASCII_RENDER (gst_ascii_render_get_type())
+G_DECLARE_FINAL_TYPE(GstAsciiRender, gst_ascii_render, GST, ASCII_RENDER, GstBaseTransform)
+
+G_END_DECLS
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <gst/video/video.h>
+#include "video_frame.h"
+
+// Raw formats AsciiConverter reads directly, in order of preference.
+#define ASCII_VIDEO_FORMATS "{ I420, NV12, RGB, BGR, RGBx, BGRx, RGBA, BGRA, GRAY8 }"
+
+inline bool toPixelFormat(GstVideoFormat format, PixelFormat* out) {
+    switch (format) {
+    case GST_VIDEO_FORMAT_RGB:  *out = PixelFormat::RGB;   return true;
+    case GST_VIDEO_FORMAT_BGR:  *out = PixelFormat::BGR;   return true;
+    case GST_VIDEO_FORMAT_RGBx: *out = PixelFormat::RGBx;  return true;
+    case GST_VIDEO_FORMAT_BGRx: *out = PixelFormat::BGRx;  return true;
+    case GST_VIDEO_FORMAT_RGBA: *out = PixelFormat::RGBA;  return true;
+    case GST_VIDEO_FORMAT_BGRA: *out = PixelFormat::BGRA;  return true;
+    case GST_VIDEO_FORMAT_I420: *out = PixelFormat::I420;  return true;
+    case GST_VIDEO_FORMAT_NV12: *out = PixelFormat::NV12;  return true;
+    case GST_VIDEO_FORMAT_GRAY8: *out = PixelFormat::GRAY8; return true;
+    default: return false;
+    }
+}
+
+// View of a mapped frame, valid until it is unmapped.
+inline VideoFrameView toVideoFrameView(const GstVideoFrame& video_frame, PixelFormat format) {
+    VideoFrameView frame;
+    frame.format = format;
+    frame.width = GST_VIDEO_FRAME_WIDTH(&video_frame);
+    frame.height = GST_VIDEO_FRAME_HEIGHT(&video_frame);
+    for (guint i = 0; i < GST_VIDEO_FRAME_N_PLANES(&video_frame) && i < 3; i++) {
+        frame.planes[i] = static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&video_frame, i));
+        frame.strides[i] = GST_VIDEO_FRAME_PLANE_STRIDE(&video_frame, i);
+    }
+    frame.limited_range = video_frame.info.colorimetry.range != GST_VIDEO_COLOR_RANGE_0_255;
+    return frame;
+}
@@ -1,14 +1,67 @@
 #include "gstreamer_pipeline.h"
-#include <gst/video/video.h>
+#include "gst_video_format.h"
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
+static const char* kAppsinkCaps = "video/x-raw,format=(string)" ASCII_VIDEO_FORMATS;
+
+// The frame is mapped in place and unmapped from the same GstVideoFrame,
+// never through a copy.
+struct VideoFrameHandle::Mapping {
+    GstSample* sample;
+    GstVideoFrame frame;
+    bool mapped;
+
+    explicit Mapping(GstSample* owned_sample)
+        : sample(owned_sample)
+        , mapped(false) {
+    }
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    ~Mapping() {
+        if (mapped) {
+            gst_video_frame_unmap(&frame);
+        }
+        gst_sample_unref(sample);
+    }
+};
+
+GstSample* VideoFrameHandle::sample() const {
+    return mapping_ ? mapping_->sample : nullptr;
+}
+
+const GstVideoInfo* VideoFrameHandle::info() const {
+    return mapping_ ? &mapping_->frame.info : nullptr;
+}
+
 GStreamerPipeline::GStreamerPipeline()
     : pipeline_(nullptr)
-    , appsink_(nullptr) {
+    , appsink_(nullptr)
+    , appsink_pad_(nullptr)
+    , video_caps_(nullptr)
+    , video_format_(PixelFormat::RGB)
+    , queue_capacity_(0)
+    , started_(false)
+    , queued_(0)
+    , worker_stopping_(false)
+    , frames_processed_(0)
+    , frames_dropped_(0)
+    , frames_late_(0)
+    , qos_enabled_(false)
+    , processing_time_(0.0)
+    , qos_overloaded_(false) {
 }
 
 GStreamerPipeline::~GStreamerPipeline() {
     stop();
+    if (video_caps_) {
+        gst_caps_unref(video_caps_);
+    }
+    if (appsink_pad_) {
+        gst_object_unref(appsink_pad_);
+    }
     if (pipeline_) {
         gst_object_unref(pipeline_);
     }
@@ -32,59 +85,299 @@ bool GStreamerPipeline::initialize(const std::string& pipeline_description) {
         return false;
     }
 
-    g_object_set(appsink_, "emit-signals", TRUE, nullptr);
+    GstCaps* caps = gst_caps_from_string(kAppsinkCaps);
+    g_object_set(appsink_, "emit-signals", TRUE, "caps", caps, nullptr);
+    gst_caps_unref(caps);
+    if (queue_capacity_ > 0) {
+        // Appsink's queue is the only one: it keeps the newest samples until
+        // the worker pulls them.
+        g_object_set(appsink_, "max-buffers", static_cast<guint>(queue_capacity_), "drop", TRUE, nullptr);
+    }
     g_signal_connect(appsink_, "new-sample", G_CALLBACK(newSampleCallback), this);
+    appsink_pad_ = gst_element_get_static_pad(appsink_, "sink");
 
     return true;
 }
 
+bool GStreamerPipeline::initializeForGrid(const std::string& source_description, int grid_width, int grid_height,
+                                          int multiple) {
+    multiple = std::max(multiple, 1);
+    std::string description = source_description +
+                              " ! videoscale ! video/x-raw,width=" + std::to_string(grid_width * multiple) +
+                              ",height=" + std::to_string(grid_height * multiple) +
+                              " ! videoconvert ! appsink name=appsink";
+    return initialize(description);
+}
+
 bool GStreamerPipeline::start() {
     if (!pipeline_) {
         return false;
     }
 
-    GstStateChangeReturn ret = gst_element_set_state(pipeline_, GST_STATE_PLAYING);
-    return ret != GST_STATE_CHANGE_FAILURE;
+    started_ = true;
+    if (queue_capacity_ > 0 && !worker_.joinable()) {
+        worker_stopping_ = false;
+        queued_ = 0;
+        worker_ = std::thread(&GStreamerPipeline::workerLoop, this);
+    }
+
+    if (gst_element_set_state(pipeline_, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        stop();
+        return false;
+    }
+    return true;
 }
 
 void GStreamerPipeline::stop() {
+    // Going to NULL deactivates appsink's pad, which waits for the streaming
+    // thread to leave newSampleCallback and flushes the queued samples.
     if (pipeline_) {
         gst_element_set_state(pipeline_, GST_STATE_NULL);
     }
+    // Stopping appsink also wakes a worker blocked in a pull; joining it
+    // waits out a callback in progress.
+    stopWorker();
+    started_ = false;
+}
+
+GstElement* GStreamerPipeline::getElement(const std::string& name) const {
+    return pipeline_ ? gst_bin_get_by_name(GST_BIN(pipeline_), name.c_str()) : nullptr;
 }
 
 void GStreamerPipeline::setFrameCallback(FrameCallback callback) {
     frame_callback_ = callback;
 }
 
+void GStreamerPipeline::setFrameHandleCallback(FrameHandleCallback callback) {
+    frame_handle_callback_ = callback;
+}
+
+bool GStreamerPipeline::setWorkerQueue(size_t queue_depth) {
+    if (started_) {
+        return false;
+    }
+    queue_capacity_ = queue_depth;
+    if (appsink_ && queue_capacity_ > 0) {
+        g_object_set(appsink_, "max-buffers", static_cast<guint>(queue_capacity_), "drop", TRUE, nullptr);
+    }
+    return true;
+}
+
+PipelineStats GStreamerPipeline::getStats() const {
+    PipelineStats stats;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        stats.queue_depth = static_cast<size_t>(std::clamp<int64_t>(queued_, 0, queue_capacity_));
+    }
+    stats.frames_processed = frames_processed_.load(std::memory_order_relaxed);
+    stats.frames_dropped = frames_dropped_.load(std::memory_order_relaxed);
+    stats.frames_late = frames_late_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Runs after appsink has queued a sample, having first discarded its oldest
+// one if the queue was full.
+void GStreamerPipeline::countQueuedSample() {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (++queued_ > static_cast<int64_t>(queue_capacity_)) {
+        queued_ = static_cast<int64_t>(queue_capacity_);
+        frames_dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void GStreamerPipeline::workerLoop() {
+    GstAppSink* appsink = GST_APP_SINK(appsink_);
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            if (worker_stopping_) {
+                return;
+            }
+        }
+        GstSample* sample = gst_app_sink_try_pull_sample(appsink, 100 * GST_MSECOND);
+        if (!sample) {
+            // Pulling returns at once while appsink is stopped or at EOS.
+            if (gst_app_sink_is_eos(appsink)) {
+                std::unique_lock<std::mutex> lock(queue_mutex_);
+                worker_wake_.wait_for(lock, std::chrono::milliseconds(10), [this] { return worker_stopping_; });
+            }
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            queued_--;
+        }
+        processFrame(sample);
+    }
+}
+
+void GStreamerPipeline::stopWorker() {
+    if (!worker_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        worker_stopping_ = true;
+    }
+    worker_wake_.notify_one();
+    worker_.join();
+}
+
+// In worker mode the sample stays in appsink for the worker to pull.
 GstFlowReturn GStreamerPipeline::newSampleCallback(GstElement* sink, gpointer user_data) {
     GStreamerPipeline* pipeline = static_cast<GStreamerPipeline*>(user_data);
+    if (pipeline->queue_capacity_ > 0) {
+        pipeline->countQueuedSample();
+        return GST_FLOW_OK;
+    }
 
     GstSample* sample = gst_app_sink_pull_sample(GST_APP_SINK(sink));
     if (sample) {
         pipeline->processFrame(sample);
+    }
+    return GST_FLOW_OK;
+}
+
+// Appsink normally hands out the same caps object for every sample, so the
+// pointer check almost always short-circuits the comparison.
+bool GStreamerPipeline::updateVideoInfo(GstCaps* caps) {
+    if (!caps) {
+        return false;
+    }
+    if (video_caps_ && (caps == video_caps_ || gst_caps_is_equal(caps, video_caps_))) {
+        return true;
+    }
+
+    if (video_caps_) {
+        gst_caps_unref(video_caps_);
+        video_caps_ = nullptr;
+    }
+    if (!gst_video_info_from_caps(&video_info_, caps) ||
+        !toPixelFormat(GST_VIDEO_INFO_FORMAT(&video_info_), &video_format_)) {
+        std::cerr << "Unsupported video caps on appsink" << std::endl;
+        return false;
+    }
+    video_caps_ = gst_caps_ref(caps);
+    return true;
+}
+
+// Takes over the caller's reference to sample.
+VideoFrameHandle GStreamerPipeline::mapFrame(GstSample* sample) {
+    VideoFrameHandle handle;
+    if (!updateVideoInfo(gst_sample_get_caps(sample))) {
         gst_sample_unref(sample);
+        return handle;
     }
 
-    return GST_FLOW_OK;
+    auto mapping = std::make_shared<VideoFrameHandle::Mapping>(sample);
+    mapping->mapped = gst_video_frame_map(&mapping->frame, &video_info_, gst_sample_get_buffer(sample),
+                                          GST_MAP_READ);
+    if (!mapping->mapped) {
+        return handle;
+    }
+
+    handle.view_ = toVideoFrameView(mapping->frame, video_format_);
+    handle.mapping_ = std::move(mapping);
+    return handle;
 }
 
+// Where sample stands against the pipeline clock. Fails before the
+// pipeline has a clock or for samples without timestamps.
+bool GStreamerPipeline::frameTiming(GstSample* sample, FrameTiming& timing) {
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    const GstSegment* segment = gst_sample_get_segment(sample);
+    if (!buffer || !segment || !GST_CLOCK_TIME_IS_VALID(GST_BUFFER_PTS(buffer))) {
+        return false;
+    }
+    timing.running_time = gst_segment_to_running_time(segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+    if (!GST_CLOCK_TIME_IS_VALID(timing.running_time)) {
+        return false;
+    }
+
+    timing.duration = GST_BUFFER_DURATION(buffer);
+    if (!GST_CLOCK_TIME_IS_VALID(timing.duration)) {
+        if (!updateVideoInfo(gst_sample_get_caps(sample)) || GST_VIDEO_INFO_FPS_N(&video_info_) <= 0) {
+            return false;
+        }
+        timing.duration = GST_SECOND * GST_VIDEO_INFO_FPS_D(&video_info_) / GST_VIDEO_INFO_FPS_N(&video_info_);
+    }
+
+    // The sample is due at its running time plus the pipeline latency, as
+    // a synchronising sink would render it. The current running time is the
+    // clock's time less the base time.
+    GstClock* clock = gst_element_get_clock(pipeline_);
+    if (!clock) {
+        return false;
+    }
+    const GstClockTime clock_time = gst_clock_get_time(clock);
+    gst_object_unref(clock);
+    const GstClockTime base_time = gst_element_get_base_time(pipeline_);
+    if (!GST_CLOCK_TIME_IS_VALID(clock_time) || !GST_CLOCK_TIME_IS_VALID(base_time) || clock_time < base_time) {
+        return false;
+    }
+    const GstClockTime now = clock_time - base_time;
+    GstClockTime due = timing.running_time;
+    const GstClockTime latency = gst_pipeline_get_latency(GST_PIPELINE(pipeline_));
+    if (GST_CLOCK_TIME_IS_VALID(latency)) {
+        due += latency;
+    }
+    timing.lateness = GST_CLOCK_DIFF(due, now);
+    return true;
+}
+
+// Proportion above 1 means frames take longer to process than to play.
+// Upstream hears about every late frame, and otherwise only when the
+// proportion crosses 1 so it can stop or resume skipping; a healthy stream
+// sends nothing.
+void GStreamerPipeline::sendQos(const FrameTiming& timing) {
+    if (!appsink_pad_ || timing.duration == 0) {
+        return;
+    }
+    const double proportion = processing_time_ / timing.duration;
+    const bool overloaded = proportion > 1.0;
+    if (timing.lateness <= 0 && overloaded == qos_overloaded_) {
+        return;
+    }
+    qos_overloaded_ = overloaded;
+    GstEvent* event = gst_event_new_qos(timing.lateness > 0 || overloaded ? GST_QOS_TYPE_OVERFLOW
+                                                                          : GST_QOS_TYPE_UNDERFLOW,
+                                        proportion, timing.lateness, timing.running_time);
+    gst_pad_push_event(appsink_pad_, event);
+}
+
+// Takes over the caller's reference to sample.
 void GStreamerPipeline::processFrame(GstSample* sample) {
-    if (!frame_callback_) {
+    if (!frame_callback_ && !frame_handle_callback_) {
+        gst_sample_unref(sample);
         return;
     }
 
-    GstBuffer* buffer = gst_sample_get_buffer(sample);
-    GstCaps* caps = gst_sample_get_caps(sample);
+    FrameTiming timing;
+    const bool timed = qos_enabled_.load(std::memory_order_relaxed) && frameTiming(sample, timing);
+    if (timed && timing.lateness > static_cast<GstClockTimeDiff>(timing.duration)) {
+        frames_late_.fetch_add(1, std::memory_order_relaxed);
+        sendQos(timing);
+        gst_sample_unref(sample);
+        return;
+    }
 
-    GstStructure* structure = gst_caps_get_structure(caps, 0);
-    int width, height;
-    gst_structure_get_int(structure, "width", &width);
-    gst_structure_get_int(structure, "height", &height);
+    auto start = std::chrono::steady_clock::now();
+    VideoFrameHandle handle = mapFrame(sample);
+    if (!handle) {
+        return;
+    }
+    if (frame_handle_callback_) {
+        frame_handle_callback_(handle);
+    }
+    if (frame_callback_) {
+        frame_callback_(handle.view());
+    }
+    frames_processed_.fetch_add(1, std::memory_order_relaxed);
 
-    GstMapInfo map;
-    if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
-        frame_callback_(map.data, width, height);
-        gst_buffer_unmap(buffer, &map);
+    if (timed) {
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        processing_time_ = processing_time_ == 0.0 ? elapsed.count()
+                                                   : processing_time_ + 0.1 * (elapsed.count() - processing_time_);
+        sendQos(timing);
     }
-}
\ No newline at end of file
+}
@@ -2,26 +2,137 @@
 
 #include <gst/gst.h>
 #include <gst/app/gstappsink.h>
+#include <gst/video/video.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "video_frame.h"
+
+// Shared reference to one mapped sample. The sample stays referenced and
+// its planes mapped until the last copy of the handle is gone, so consumers
+// may keep frames past the callback or pass them to other threads without
+// copying pixels.
+class VideoFrameHandle {
+public:
+    VideoFrameHandle() = default;
+
+    explicit operator bool() const { return mapping_ != nullptr; }
+    const VideoFrameView& view() const { return view_; }
+    GstSample* sample() const;
+    // Video info of the caps the sample arrived with.
+    const GstVideoInfo* info() const;
+
+private:
+    friend class GStreamerPipeline;
+    struct Mapping;
+
+    std::shared_ptr<const Mapping> mapping_;
+    VideoFrameView view_;
+};
+
+// Appsink does not report its drops, so queue_depth and frames_dropped are
+// counted from its new-sample signals and the worker's pulls; a pull racing
+// a signal can move a drop by one frame.
+struct PipelineStats {
+    size_t queue_depth;         // samples waiting in appsink for the worker
+    uint64_t frames_processed;  // samples handed to the frame callback
+    uint64_t frames_dropped;    // samples appsink discarded because its queue was full
+    uint64_t frames_late;       // samples skipped unmapped because they were already late
+};
 
 class GStreamerPipeline {
 public:
-    using FrameCallback = std::function<void(const uint8_t*, int, int)>;
+    using FrameCallback = std::function<void(const VideoFrameView&)>;
+    using FrameHandleCallback = std::function<void(const VideoFrameHandle&)>;
 
     GStreamerPipeline();
     ~GStreamerPipeline();
 
     bool initialize(const std::string& pipeline_description);
+
+    // Builds the rest of the pipeline after source_description: the source
+    // is scaled in its own (usually YUV) format to multiple pixels per cell of
+    // a grid_width x grid_height grid, and only that small frame is converted,
+    // if appsink cannot take it as is.
+    bool initializeForGrid(const std::string& source_description, int grid_width, int grid_height,
+                           int multiple = 2);
     bool start();
+    // Returns once the streaming thread and the worker have left the frame
+    // callbacks; none run afterwards, so whatever they use may be destroyed.
+    // Must not be called from a frame callback.
     void stop();
 
+    // New reference to the element called name, for setting properties or
+    // adding probes; nullptr if there is none. Release with gst_object_unref.
+    GstElement* getElement(const std::string& name) const;
+
     void setFrameCallback(FrameCallback callback);
+    // Alternative to the view callback for consumers that keep frames.
+    void setFrameHandleCallback(FrameHandleCallback callback);
+
+    // With queue_depth > 0, appsink keeps up to queue_depth samples and a
+    // worker thread pulls them and runs the frame callback, so a slow
+    // callback makes appsink drop the oldest samples instead of stalling
+    // decoding. 0 (the default) runs the callback on the streaming thread.
+    // Returns false, changing nothing, once start() has been called.
+    bool setWorkerQueue(size_t queue_depth);
+    PipelineStats getStats() const;
+
+    // Times the frame callback against the frame duration and sends QoS
+    // events upstream for late frames and whenever processing starts or stops
+    // keeping up, so decoders can skip frames that would be thrown away. A
+    // sample already more than a frame past its due time is dropped before it
+    // is mapped. May be called while the pipeline runs.
+    void setQosEnabled(bool enabled) { qos_enabled_.store(enabled, std::memory_order_relaxed); }
 
 private:
     GstElement* pipeline_;
     GstElement* appsink_;
+    GstPad* appsink_pad_;
     FrameCallback frame_callback_;
+    FrameHandleCallback frame_handle_callback_;
+
+    // Video info parsed from the last caps seen; only re-parsed when the
+    // caps change.
+    GstCaps* video_caps_;
+    GstVideoInfo video_info_;
+    PixelFormat video_format_;
+
+    // Fixed while the pipeline runs; read by the streaming thread.
+    size_t queue_capacity_;
+    bool started_;
+    int64_t queued_;                // samples in appsink, may dip below 0 briefly
+    mutable std::mutex queue_mutex_;
+    std::condition_variable worker_wake_;
+    bool worker_stopping_;
+    std::thread worker_;
+    std::atomic<uint64_t> frames_processed_;
+    std::atomic<uint64_t> frames_dropped_;
+    std::atomic<uint64_t> frames_late_;
+
+    std::atomic<bool> qos_enabled_;
+
+    // Used only by the thread running the callback.
+    struct FrameTiming {
+        GstClockTime running_time;
+        GstClockTime duration;
+        GstClockTimeDiff lateness;  // how far past its due time, latency included, the sample is
+    };
+    double processing_time_;        // moving average, in nanoseconds
+    bool qos_overloaded_;           // last proportion sent upstream was above 1
 
     static GstFlowReturn newSampleCallback(GstElement* sink, gpointer user_data);
+    void countQueuedSample();
+    void workerLoop();
+    void stopWorker();
+    bool updateVideoInfo(GstCaps* caps);
+    VideoFrameHandle mapFrame(GstSample* sample);
+    bool frameTiming(GstSample* sample, FrameTiming& timing);
+    void sendQos(const FrameTiming& timing);
     void processFrame(GstSample* sample);
-};
\ No newline at end of file
+};
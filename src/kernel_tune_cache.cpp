@@ -0,0 +1,74 @@
+#include "kernel_tune_cache.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <unistd.h>
+
+KernelTuneCache::KernelTuneCache(std::string path)
+    : path_(std::move(path)) {
+    load();
+}
+
+// Adds the file's entries, keeping any this cache already holds.
+void KernelTuneCache::load() {
+    std::ifstream file(path_);
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream fields(line);
+        std::string key;
+        std::string isa_name;
+        KernelChoice choice;
+        if (!(fields >> key >> isa_name >> choice.threads) || choice.threads < 1 ||
+            !kernelIsaFromName(isa_name, choice.isa)) {
+            continue;
+        }
+        entries_.emplace(key, choice);
+    }
+}
+
+bool KernelTuneCache::lookup(const std::string& key, KernelChoice& choice) const {
+    auto it = entries_.find(key);
+    if (it == entries_.end() || !kernelIsaSupported(it->second.isa)) {
+        return false;
+    }
+    choice = it->second;
+    return true;
+}
+
+bool KernelTuneCache::store(const std::string& key, KernelChoice choice) {
+    entries_[key] = choice;
+    if (path_.empty()) {
+        return false;
+    }
+
+    // Pick up what other processes stored since, then write a uniquely named
+    // sibling file and rename it over the cache, so neither a crash nor a
+    // concurrent writer leaves a half-written file behind.
+    load();
+    std::ostringstream text;
+    for (const auto& entry : entries_) {
+        text << entry.first << ' ' << kernelIsaName(entry.second.isa) << ' ' << entry.second.threads << '\n';
+    }
+    const std::string contents = text.str();
+
+    std::string temp_path = path_ + ".XXXXXX";
+    const int fd = mkstemp(&temp_path[0]);
+    if (fd < 0) {
+        return false;
+    }
+    size_t written = 0;
+    while (written < contents.size()) {
+        const ssize_t n = write(fd, contents.data() + written, contents.size() - written);
+        if (n <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(n);
+    }
+    if (close(fd) != 0 || written < contents.size() || std::rename(temp_path.c_str(), path_.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include "ascii_kernels.h"
+
+struct KernelChoice {
+    KernelIsa isa;
+    int threads;
+};
+
+// Fastest kernel found for each conversion geometry, kept in a text file
+// with one "<geometry key> <isa name> <threads>" line per geometry so later
+// runs can skip benchmarking. A missing or unreadable file is an empty cache.
+class KernelTuneCache {
+public:
+    explicit KernelTuneCache(std::string path);
+
+    const std::string& getPath() const { return path_; }
+
+    // Entries naming an ISA this CPU lacks are ignored.
+    bool lookup(const std::string& key, KernelChoice& choice) const;
+
+    // Records choice and rewrites the file, merging in entries other
+    // processes stored meanwhile; returns false if writing failed.
+    bool store(const std::string& key, KernelChoice choice);
+
+private:
+    std::string path_;
+    std::map<std::string, KernelChoice> entries_;
+
+    void load();
+};
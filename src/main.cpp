@@ -1,5 +1,6 @@
 #include <iostream>
 #include <chrono>
+#include <cstdlib>
 #include <thread>
 #include <signal.h>
 #include <string>
@@ -9,7 +10,7 @@
 #include "gl_window.h"
 
 static bool running = true;
-static std::string current_ascii_frame;
+static GlyphIndexFrame current_ascii_frame;
 static std::mutex frame_mutex;
 
 void signalHandler(int signal) {
@@ -25,41 +26,88 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // The frame callback uses the converter and converted_frame, so both are
+    // declared before the pipeline, whose destructor stops it, and outlive
+    // every callback on any return path.
     AsciiConverter converter(128, 64);
+    // Converted into off-lock, then swapped with the displayed frame; both
+    // buffers are reused so steady-state frames don't allocate.
+    GlyphIndexFrame converted_frame;
     GStreamerPipeline pipeline;
 
-    std::string pipeline_str;
+    // --kernel=<scalar|sse4.1|avx2>[:threads] forces a kernel; otherwise the
+    // converter tunes itself and remembers the result across runs.
+    std::string source;
+    std::string forced_kernel;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--kernel=", 0) == 0) {
+            forced_kernel = arg.substr(9);
+        } else if (source.empty()) {
+            source = arg;
+        }
+    }
+
+    if (!forced_kernel.empty()) {
+        size_t colon = forced_kernel.find(':');
+        KernelIsa isa;
+        if (!kernelIsaFromName(forced_kernel.substr(0, colon), isa) || !converter.setKernelIsa(isa)) {
+            std::cerr << "Unsupported kernel: " << forced_kernel << std::endl;
+            return 1;
+        }
+        if (colon != std::string::npos) {
+            converter.setThreadCount(std::atoi(forced_kernel.c_str() + colon + 1));
+        }
+    } else {
+        const char* home = std::getenv("HOME");
+        converter.setAutotune(true, home ? std::string(home) + "/.img2ascii_kernels" : ".img2ascii_kernels");
+    }
 
-    if (argc > 1) {
-        std::string source = argv[1];
+    // Sources are scaled to this many pixels per cell before conversion, and
+    // the converter averages them.
+    const int source_pixels_per_cell = 2;
+    converter.setSamplingMode(SamplingMode::Area);
+    std::string source_str;
+
+    if (!source.empty()) {
         if (source == "webcam") {
-            pipeline_str = "avfvideosrc ! videoconvert ! video/x-raw,format=RGB,width=320,height=240,framerate=30/1 ! appsink name=appsink";
+            source_str = "avfvideosrc ! video/x-raw,framerate=30/1";
         } else if (source == "smpte") {
-            pipeline_str = "videotestsrc pattern=smpte ! videoconvert ! video/x-raw,format=RGB,width=320,height=240,framerate=30/1 ! appsink name=appsink";
+            source_str = "videotestsrc pattern=smpte ! video/x-raw,framerate=30/1";
         } else if (source == "checkers") {
-            pipeline_str = "videotestsrc pattern=checkers-1 ! videoconvert ! video/x-raw,format=RGB,width=320,height=240,framerate=30/1 ! appsink name=appsink";
+            source_str = "videotestsrc pattern=checkers-1 ! video/x-raw,framerate=30/1";
         } else if (source == "circular") {
-            pipeline_str = "videotestsrc pattern=circular ! videoconvert ! video/x-raw,format=RGB,width=320,height=240,framerate=30/1 ! appsink name=appsink";
+            source_str = "videotestsrc pattern=circular ! video/x-raw,framerate=30/1";
         } else if (source.find(".") != std::string::npos) {
-            pipeline_str = "filesrc location=" + source + " ! decodebin ! videoconvert ! video/x-raw,format=RGB,width=320,height=240,framerate=30/1 ! appsink name=appsink";
+            source_str = "filesrc location=" + source + " ! decodebin";
         } else {
-            std::cout << "Usage: " << argv[0] << " [webcam|smpte|checkers|circular|video_file.mp4]" << std::endl;
+            std::cout << "Usage: " << argv[0]
+                      << " [--kernel=scalar|sse4.1|avx2[:threads]] [webcam|smpte|checkers|circular|video_file.mp4]"
+                      << std::endl;
             return 1;
         }
     } else {
-        pipeline_str = "videotestsrc pattern=ball ! videoconvert ! video/x-raw,format=RGB,width=320,height=240,framerate=30/1 ! appsink name=appsink";
+        source_str = "videotestsrc pattern=ball ! video/x-raw,framerate=30/1";
     }
 
-    if (!pipeline.initialize(pipeline_str)) {
+    // Convert on a worker so a slow frame drops queued ones instead of
+    // stalling the decoder, and let upstream know when we fall behind.
+    pipeline.setWorkerQueue(2);
+    pipeline.setQosEnabled(true);
+    if (!pipeline.initializeForGrid(source_str, converter.getOutputWidth(), converter.getOutputHeight(),
+                                    source_pixels_per_cell)) {
         std::cerr << "Failed to initialize pipeline" << std::endl;
         return 1;
     }
 
-    pipeline.setFrameCallback([&converter](const uint8_t* data, int width, int height) {
-        std::string ascii_frame = converter.convertRGBBuffer(data, width, height);
+    // Frames carry palette indices; glyphs are only looked up when drawing.
+    const std::string palette = converter.getAsciiChars();
+
+    pipeline.setFrameCallback([&converter, &converted_frame](const VideoFrameView& frame) {
+        converter.convertIndicesInto(frame, converted_frame);
 
         std::lock_guard<std::mutex> lock(frame_mutex);
-        current_ascii_frame = ascii_frame;
+        std::swap(current_ascii_frame, converted_frame);
     });
 
     std::cout << "Starting ASCII video stream in OpenGL window (ESC to quit)..." << std::endl;
@@ -82,8 +130,8 @@ int main(int argc, char* argv[]) {
 
         {
             std::lock_guard<std::mutex> lock(frame_mutex);
-            if (!current_ascii_frame.empty()) {
-                renderer->renderText(current_ascii_frame, 10.0f, 20.0f, 1.0f);
+            if (current_ascii_frame.height > 0) {
+                renderer->renderGlyphIndices(current_ascii_frame, palette, 10.0f, 20.0f, 1.0f);
             }
         }
 
@@ -92,7 +140,9 @@ int main(int argc, char* argv[]) {
 
         auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(current_time - last_time);
         if (duration.count() >= 1000) {
-            std::string fps_text = "FPS: " + std::to_string(frame_count);
+            PipelineStats stats = pipeline.getStats();
+            std::string fps_text = "FPS: " + std::to_string(frame_count) +
+                                   "  dropped: " + std::to_string(stats.frames_dropped + stats.frames_late);
             renderer->setColor(1.0f, 1.0f, 0.0f, 1.0f);
             renderer->renderText(fps_text, 10.0f, window.getHeight() - 30.0f, 1.0f);
 
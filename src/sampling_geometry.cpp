@@ -0,0 +1,160 @@
+#include "sampling_geometry.h"
+#include "glyph_bitmaps.h"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+static void buildNearest(SamplingGeometry& g) {
+    const int bytes_per_pixel = pixelStride(g.format);
+    const int row_bytes = g.input_width * bytes_per_pixel;
+    float scale_x = static_cast<float>(g.input_width) / g.output_width;
+    float scale_y = static_cast<float>(g.input_height) / g.output_height;
+
+    g.col_offsets.assign(g.output_width, 0);
+    g.valid_cols = 0;
+    int last_row_vector_cols = 0;
+    for (int x = 0; x < g.output_width; x++) {
+        int src_x = static_cast<int>(x * scale_x);
+        if (src_x >= g.input_width) {
+            break;
+        }
+        g.col_offsets[x] = src_x * bytes_per_pixel;
+        g.valid_cols = x + 1;
+        if (src_x * bytes_per_pixel + 4 <= row_bytes) {
+            last_row_vector_cols = g.valid_cols;
+        }
+    }
+
+    // Only 3-byte pixels can overrun the last row with a 4-byte load.
+    if (bytes_per_pixel != 3) {
+        last_row_vector_cols = g.valid_cols;
+    }
+
+    g.row_offsets.assign(g.output_height, -1);
+    g.row_vector_cols.assign(g.output_height, 0);
+    for (int y = 0; y < g.output_height; y++) {
+        int src_y = static_cast<int>(y * scale_y);
+        if (src_y >= g.input_height) {
+            continue;
+        }
+        g.row_offsets[y] = static_cast<ptrdiff_t>(src_y) * g.strides[0];
+        g.row_vector_cols[y] = (src_y == g.input_height - 1) ? last_row_vector_cols : g.valid_cols;
+    }
+
+    if (!isYUV(g.format)) {
+        return;
+    }
+
+    // 4:2:0 chroma: one sample per 2x2 luma block, interleaved UV for NV12.
+    const int chroma_step = g.format == PixelFormat::NV12 ? 2 : 1;
+    g.chroma_col_offsets.assign(g.output_width, 0);
+    for (int x = 0; x < g.valid_cols; x++) {
+        g.chroma_col_offsets[x] = (g.col_offsets[x] / 2) * chroma_step;
+    }
+    g.chroma_row_offsets.assign(g.output_height, -1);
+    g.v_row_offsets.assign(g.output_height, -1);
+    for (int y = 0; y < g.output_height; y++) {
+        if (g.row_offsets[y] >= 0) {
+            const ptrdiff_t chroma_y = g.row_offsets[y] / g.strides[0] / 2;
+            g.chroma_row_offsets[y] = chroma_y * g.strides[1];
+            g.v_row_offsets[y] = chroma_y * g.strides[2];
+        }
+    }
+}
+
+static void buildBounds(int input, int output, std::vector<int>& begin, std::vector<int>& end) {
+    begin.resize(output);
+    end.resize(output);
+    for (int i = 0; i < output; i++) {
+        begin[i] = static_cast<int>(static_cast<int64_t>(i) * input / output);
+        end[i] = std::max(static_cast<int>(static_cast<int64_t>(i + 1) * input / output), begin[i] + 1);
+    }
+}
+
+static void buildChromaBounds(int input, const std::vector<int>& begin, const std::vector<int>& end,
+                              std::vector<int>& chroma_begin, std::vector<int>& chroma_end) {
+    const int chroma_size = (input + 1) / 2;
+    chroma_begin.resize(begin.size());
+    chroma_end.resize(end.size());
+    for (size_t i = 0; i < begin.size(); i++) {
+        chroma_begin[i] = begin[i] / 2;
+        chroma_end[i] = std::min(std::max((end[i] + 1) / 2, chroma_begin[i] + 1), chroma_size);
+    }
+}
+
+static void buildLattice(const SamplingGeometry& g, int cols_per_cell, int rows_per_cell, CellLattice& lattice) {
+    const int bytes_per_pixel = pixelStride(g.format);
+    const int row_bytes = g.input_width * bytes_per_pixel;
+
+    lattice.cols_per_cell = cols_per_cell;
+    lattice.rows_per_cell = rows_per_cell;
+    lattice.col_offsets.resize(static_cast<size_t>(g.output_width) * cols_per_cell);
+    lattice.vector_cols = bytes_per_pixel == 3 ? 0 : static_cast<int>(lattice.col_offsets.size());
+    for (int x = 0; x < g.output_width; x++) {
+        int span = g.col_end[x] - g.col_bounds[x];
+        for (int i = 0; i < cols_per_cell; i++) {
+            int offset = (g.col_bounds[x] + span * (2 * i + 1) / (2 * cols_per_cell)) * bytes_per_pixel;
+            lattice.col_offsets[x * cols_per_cell + i] = offset;
+            if (bytes_per_pixel == 3 && offset + 4 <= row_bytes) {
+                lattice.vector_cols = x * cols_per_cell + i + 1;
+            }
+        }
+    }
+
+    lattice.row_offsets.resize(static_cast<size_t>(g.output_height) * rows_per_cell);
+    for (int y = 0; y < g.output_height; y++) {
+        int span = g.row_end[y] - g.row_bounds[y];
+        for (int j = 0; j < rows_per_cell; j++) {
+            int src_y = g.row_bounds[y] + span * (2 * j + 1) / (2 * rows_per_cell);
+            lattice.row_offsets[y * rows_per_cell + j] = static_cast<ptrdiff_t>(src_y) * g.strides[0];
+        }
+    }
+}
+
+std::shared_ptr<const SamplingGeometry> SamplingGeometry::acquire(const VideoFrameView& frame,
+                                                                  int output_width, int output_height) {
+    using Key = std::tuple<PixelFormat, int, int, int, int, int, int, int>;
+    static std::mutex cache_mutex;
+    static std::map<Key, std::weak_ptr<const SamplingGeometry>> cache;
+
+    Key key(frame.format, frame.width, frame.height, frame.strides[0], frame.strides[1],
+            frame.strides[2], output_width, output_height);
+    std::lock_guard<std::mutex> lock(cache_mutex);
+
+    auto it = cache.find(key);
+    if (it != cache.end()) {
+        if (auto shared = it->second.lock()) {
+            return shared;
+        }
+    }
+
+    auto geometry = std::make_shared<SamplingGeometry>();
+    geometry->format = frame.format;
+    geometry->input_width = frame.width;
+    geometry->input_height = frame.height;
+    geometry->strides[0] = frame.strides[0];
+    geometry->strides[1] = frame.strides[1];
+    geometry->strides[2] = frame.strides[2];
+    geometry->output_width = output_width;
+    geometry->output_height = output_height;
+    buildNearest(*geometry);
+    buildBounds(frame.width, output_width, geometry->col_bounds, geometry->col_end);
+    buildBounds(frame.height, output_height, geometry->row_bounds, geometry->row_end);
+    buildLattice(*geometry, kGlyphWidth, kGlyphHeight, geometry->shape_lattice);
+    buildLattice(*geometry, 2, 4, geometry->dot_lattice);
+    if (isYUV(frame.format)) {
+        buildChromaBounds(frame.width, geometry->col_bounds, geometry->col_end,
+                          geometry->chroma_col_bounds, geometry->chroma_col_end);
+        buildChromaBounds(frame.height, geometry->row_bounds, geometry->row_end,
+                          geometry->chroma_row_bounds, geometry->chroma_row_end);
+    }
+
+    // Drop entries whose converters have all moved on to other sizes.
+    for (auto entry = cache.begin(); entry != cache.end();) {
+        entry = entry->second.expired() ? cache.erase(entry) : std::next(entry);
+    }
+    cache[key] = geometry;
+    return geometry;
+}
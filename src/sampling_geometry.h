@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "video_frame.h"
+
+// Regular grid of cols_per_cell x rows_per_cell sample points per cell,
+// spread evenly over the cell's area bounds. col_offsets are byte offsets
+// within a plane 0 row, cell-major; row_offsets hold rows_per_cell entries
+// per output row. The first vector_cols column offsets can be read with
+// 4-byte loads on any row.
+struct CellLattice {
+    int cols_per_cell = 0;
+    int rows_per_cell = 0;
+    std::vector<int> col_offsets;
+    std::vector<ptrdiff_t> row_offsets;
+    int vector_cols = 0;
+};
+
+// Precomputed source sampling tables for one frame layout (format, size and
+// strides) and output grid size. Tables are immutable once built and shared
+// by every converter with the same geometry, so the per-frame loops only do
+// lookups.
+struct SamplingGeometry {
+    PixelFormat format;
+    int input_width;
+    int input_height;
+    int strides[3];
+    int output_width;
+    int output_height;
+
+    // Nearest: byte offset of each cell's sampled pixel within its plane 0 row
+    // and of each output row's source row (-1 when it falls outside the frame).
+    // Sampled columns only grow with x, so the in-frame ones are the first
+    // valid_cols. row_vector_cols[y] is how many of those can be read with
+    // 4-byte loads without running past the end of the buffer.
+    std::vector<int> col_offsets;
+    std::vector<ptrdiff_t> row_offsets;
+    std::vector<int> row_vector_cols;
+    int valid_cols;
+
+    // Nearest, YUV only: the same offsets into the chroma plane(s). I420's
+    // V plane rows use v_row_offsets, as its stride may differ from U's.
+    std::vector<int> chroma_col_offsets;
+    std::vector<ptrdiff_t> chroma_row_offsets;
+    std::vector<ptrdiff_t> v_row_offsets;
+
+    // Area: cell x covers source columns [col_bounds[x], col_end[x]), and
+    // likewise for rows. The chroma bounds cover the subsampled planes.
+    std::vector<int> col_bounds;
+    std::vector<int> col_end;
+    std::vector<int> row_bounds;
+    std::vector<int> row_end;
+    std::vector<int> chroma_col_bounds;
+    std::vector<int> chroma_col_end;
+    std::vector<int> chroma_row_bounds;
+    std::vector<int> chroma_row_end;
+
+    // Shape and edge glyphs: one sample per font pixel. Dots (Braille and
+    // half blocks): 2 x 4 per cell.
+    CellLattice shape_lattice;
+    CellLattice dot_lattice;
+
+    static std::shared_ptr<const SamplingGeometry> acquire(const VideoFrameView& frame,
+                                                           int output_width, int output_height);
+
+    bool matches(const VideoFrameView& frame, int out_w, int out_h) const {
+        return format == frame.format && input_width == frame.width && input_height == frame.height &&
+               strides[0] == frame.strides[0] && strides[1] == frame.strides[1] &&
+               strides[2] == frame.strides[2] &&
+               output_width == out_w && output_height == out_h;
+    }
+};
@@ -0,0 +1,77 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(int worker_count)
+    : generation_(0)
+    , busy_workers_(0)
+    , stopping_(false)
+    , task_fn_(nullptr)
+    , task_context_(nullptr)
+    , task_count_(0)
+    , next_task_(0) {
+    for (int i = 0; i < worker_count; i++) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::dispatch(int count, TaskFn fn, void* context) {
+    if (workers_.empty() || count <= 1) {
+        for (int i = 0; i < count; i++) {
+            fn(context, i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_fn_ = fn;
+        task_context_ = context;
+        task_count_ = count;
+        next_task_.store(0, std::memory_order_relaxed);
+        busy_workers_ = static_cast<int>(workers_.size());
+        generation_++;
+    }
+    wake_cv_.notify_all();
+
+    drainTasks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this] { return busy_workers_ == 0; });
+}
+
+void ThreadPool::drainTasks() {
+    for (int i = next_task_.fetch_add(1); i < task_count_; i = next_task_.fetch_add(1)) {
+        task_fn_(task_context_, i);
+    }
+}
+
+void ThreadPool::workerLoop() {
+    uint64_t seen_generation = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_cv_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+        }
+
+        drainTasks();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_workers_ == 0) {
+            done_cv_.notify_one();
+        }
+    }
+}
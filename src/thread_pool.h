@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads that run indexed tasks on request. Threads are
+// started once and sleep between runs, so per-frame dispatch costs a wake-up
+// rather than a thread creation.
+class ThreadPool {
+public:
+    explicit ThreadPool(int worker_count);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int getWorkerCount() const { return static_cast<int>(workers_.size()); }
+
+    // Calls task(i) for every i in [0, count) on the workers and the calling
+    // thread, returning once all calls have finished.
+    template <typename Task>
+    void run(int count, Task&& task) {
+        dispatch(count, &invoke<std::remove_reference_t<Task>>, &task);
+    }
+
+private:
+    using TaskFn = void (*)(void*, int);
+
+    template <typename Task>
+    static void invoke(void* context, int index) {
+        (*static_cast<Task*>(context))(index);
+    }
+
+    void dispatch(int count, TaskFn fn, void* context);
+    void drainTasks();
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_;
+    int busy_workers_;
+    bool stopping_;
+
+    TaskFn task_fn_;
+    void* task_context_;
+    int task_count_;
+    std::atomic<int> next_task_;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+
+enum class PixelFormat {
+    RGB,
+    BGR,
+    RGBx,
+    BGRx,
+    RGBA,
+    BGRA,
+    I420,
+    NV12,
+    GRAY8
+};
+
+// Non-owning description of one video frame: plane pointers and row strides
+// in bytes. Packed RGB formats and GRAY8 use plane 0 only; I420 uses Y, U and
+// V planes, NV12 Y and interleaved UV.
+struct VideoFrameView {
+    PixelFormat format = PixelFormat::RGB;
+    int width = 0;
+    int height = 0;
+    const uint8_t* planes[3] = {nullptr, nullptr, nullptr};
+    int strides[3] = {0, 0, 0};
+    bool limited_range = true;  // YUV only: luma spans 16..235
+
+    static VideoFrameView packedRGB(const uint8_t* data, int width, int height) {
+        VideoFrameView frame;
+        frame.format = PixelFormat::RGB;
+        frame.width = width;
+        frame.height = height;
+        frame.planes[0] = data;
+        frame.strides[0] = width * 3;
+        return frame;
+    }
+};
+
+// Bytes per pixel in plane 0.
+inline int pixelStride(PixelFormat format) {
+    switch (format) {
+    case PixelFormat::RGB:
+    case PixelFormat::BGR:
+        return 3;
+    case PixelFormat::RGBx:
+    case PixelFormat::BGRx:
+    case PixelFormat::RGBA:
+    case PixelFormat::BGRA:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+inline bool isPackedRGB(PixelFormat format) {
+    return pixelStride(format) > 1;
+}
+
+inline bool isBlueFirst(PixelFormat format) {
+    return format == PixelFormat::BGR || format == PixelFormat::BGRx || format == PixelFormat::BGRA;
+}
+
+inline bool isYUV(PixelFormat format) {
+    return format == PixelFormat::I420 || format == PixelFormat::NV12;
+}
@@ -0,0 +1,165 @@
+#include "xterm_palette.h"
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+const uint8_t kCubeLevels[6] = {0, 95, 135, 175, 215, 255};
+
+// The cube is a product of per-channel levels, so its nearest entry is the
+// nearest level of each channel; the nearest gray step depends only on
+// r + g + b. Ties resolve to the lower level or step, as in the exhaustive
+// search.
+struct NearestTables {
+    uint8_t cube_level[256];
+    uint8_t gray_step[256 * 3 - 2];
+
+    NearestTables() {
+        for (int c = 0; c < 256; c++) {
+            int best = 0;
+            for (int i = 1; i < 6; i++) {
+                if (std::abs(c - kCubeLevels[i]) < std::abs(c - kCubeLevels[best])) {
+                    best = i;
+                }
+            }
+            cube_level[c] = static_cast<uint8_t>(best);
+        }
+        for (int sum = 0; sum < 256 * 3 - 2; sum++) {
+            int best = 0;
+            for (int i = 1; i < 24; i++) {
+                if (std::abs(sum - 3 * (8 + 10 * i)) < std::abs(sum - 3 * (8 + 10 * best))) {
+                    best = i;
+                }
+            }
+            gray_step[sum] = static_cast<uint8_t>(best);
+        }
+    }
+};
+
+const NearestTables& nearestTables() {
+    static const NearestTables tables;
+    return tables;
+}
+
+// Same result as xterm256Nearest: the nearest cube entry against the nearest
+// gray step, the cube winning ties as it has the lower indices.
+uint8_t nearestSeparable(const NearestTables& tables, int r, int g, int b) {
+    const int ri = tables.cube_level[r];
+    const int gi = tables.cube_level[g];
+    const int bi = tables.cube_level[b];
+    const int cr = r - kCubeLevels[ri], cg = g - kCubeLevels[gi], cb = b - kCubeLevels[bi];
+    const int step = tables.gray_step[r + g + b];
+    const int gray = 8 + 10 * step;
+    const int gr = r - gray, gg = g - gray, gb = b - gray;
+    if (gr * gr + gg * gg + gb * gb < cr * cr + cg * cg + cb * cb) {
+        return static_cast<uint8_t>(232 + step);
+    }
+    return static_cast<uint8_t>(16 + 36 * ri + 6 * gi + bi);
+}
+
+} // namespace
+
+void xterm256Rgb(uint8_t index, uint8_t* rgb) {
+    if (index >= 232) {
+        rgb[0] = rgb[1] = rgb[2] = static_cast<uint8_t>(8 + 10 * (index - 232));
+        return;
+    }
+    int cube = index < 16 ? 0 : index - 16;
+    rgb[0] = kCubeLevels[cube / 36];
+    rgb[1] = kCubeLevels[(cube / 6) % 6];
+    rgb[2] = kCubeLevels[cube % 6];
+}
+
+uint8_t xterm256Nearest(uint8_t r, uint8_t g, uint8_t b) {
+    int best = 16;
+    int best_distance = 1 << 30;
+    for (int i = 16; i < 256; i++) {
+        uint8_t rgb[3];
+        xterm256Rgb(static_cast<uint8_t>(i), rgb);
+        int dr = r - rgb[0], dg = g - rgb[1], db = b - rgb[2];
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+    return static_cast<uint8_t>(best);
+}
+
+const uint8_t* xterm256Lut() {
+    // Padded so the gather kernels can load a dword at the last entry.
+    static const std::vector<uint8_t> lut = [] {
+        const NearestTables& tables = nearestTables();
+        std::vector<uint8_t> table(32 * 32 * 32 + 3, 0);
+        for (int key = 0; key < 32 * 32 * 32; key++) {
+            const int lo[3] = {(key >> 10) << 3, ((key >> 5) & 31) << 3, (key & 31) << 3};
+            int level_lo[3];
+            int level_hi[3];
+            for (int c = 0; c < 3; c++) {
+                level_lo[c] = tables.cube_level[lo[c]];
+                level_hi[c] = tables.cube_level[lo[c] + 7];
+            }
+            const int sum = lo[0] + lo[1] + lo[2];
+            const int step_lo = tables.gray_step[sum];
+            const int step_hi = tables.gray_step[sum + 21];
+            const bool one_cube = level_lo[0] == level_hi[0] && level_lo[1] == level_hi[1] &&
+                                  level_lo[2] == level_hi[2];
+            if (!one_cube && step_lo != step_hi) {
+                continue;
+            }
+
+            // For a fixed cube entry and gray step the difference of their
+            // squared distances is linear in r, g and b, so its sign holds
+            // over the whole bin when it holds at the eight corners. One
+            // cube entry wins the bin if it is no farther than every gray
+            // step in range at every corner; one gray step if it is strictly
+            // closer than every cube entry in range.
+            bool cube_wins = one_cube;
+            bool gray_wins = step_lo == step_hi;
+            for (int ri = level_lo[0]; ri <= level_hi[0]; ri++) {
+                for (int gi = level_lo[1]; gi <= level_hi[1]; gi++) {
+                    for (int bi = level_lo[2]; bi <= level_hi[2]; bi++) {
+                        for (int step = step_lo; step <= step_hi; step++) {
+                            const int gray = 8 + 10 * step;
+                            for (int corner = 0; corner < 8; corner++) {
+                                const int r = lo[0] + (corner & 4 ? 7 : 0);
+                                const int g = lo[1] + (corner & 2 ? 7 : 0);
+                                const int b = lo[2] + (corner & 1 ? 7 : 0);
+                                const int cr = r - kCubeLevels[ri];
+                                const int cg = g - kCubeLevels[gi];
+                                const int cb = b - kCubeLevels[bi];
+                                const int gr = r - gray, gg = g - gray, gb = b - gray;
+                                const int difference = (cr * cr + cg * cg + cb * cb) -
+                                                       (gr * gr + gg * gg + gb * gb);
+                                cube_wins = cube_wins && difference <= 0;
+                                gray_wins = gray_wins && difference > 0;
+                            }
+                        }
+                    }
+                }
+            }
+            if (cube_wins) {
+                table[key] = static_cast<uint8_t>(16 + 36 * level_lo[0] + 6 * level_lo[1] + level_lo[2]);
+            } else if (gray_wins) {
+                table[key] = static_cast<uint8_t>(232 + step_lo);
+            }
+        }
+        return table;
+    }();
+    return lut.data();
+}
+
+void quantizeXterm256(const ColorAsciiFrame& frame, AlignedBuffer& out, KernelIsa isa) {
+    const size_t cells = static_cast<size_t>(frame.width) * frame.height;
+    out.resize(cells);
+    rgb555LookupKernel(isa)(frame.red.data(), frame.green.data(), frame.blue.data(), static_cast<int>(cells),
+                            xterm256Lut(), out.data());
+
+    const NearestTables& tables = nearestTables();
+    uint8_t* index = out.data();
+    for (size_t i = 0; i < cells; i++) {
+        if (index[i] == 0) {
+            index[i] = nearestSeparable(tables, frame.red.data()[i], frame.green.data()[i], frame.blue.data()[i]);
+        }
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include "ascii_frame.h"
+#include "ascii_kernels.h"
+
+// Colours 16..255 of the xterm-256 palette: the 6x6x6 cube and the 24-step
+// gray ramp. 0..15 are left out since terminals theme them freely.
+void xterm256Rgb(uint8_t index, uint8_t* rgb);
+
+// Exhaustive nearest-colour search (squared RGB distance) over 16..255.
+uint8_t xterm256Nearest(uint8_t r, uint8_t g, uint8_t b);
+
+// Nearest colour of every 5-bit-per-channel RGB bin whose colours all share
+// it, or 0 for the bins that straddle a cube level or gray step. Built on
+// first use and shared by every caller in the process.
+const uint8_t* xterm256Lut();
+
+// xterm-256 index for every cell of a colour frame, one byte per cell, equal
+// to xterm256Nearest. Cells in undecided bins of the lookup table are
+// resolved exactly after the isa lookup kernel has run.
+void quantizeXterm256(const ColorAsciiFrame& frame, AlignedBuffer& out, KernelIsa isa);
@@ -0,0 +1,1090 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include "ascii_converter.h"
+#include "ascii_frame.h"
+#include "ascii_kernels.h"
+#include "glyph_bitmaps.h"
+#include "test_harness.h"
+#include "xterm_palette.h"
+
+namespace {
+
+const KernelIsa kVectorIsas[] = {KernelIsa::SSE41, KernelIsa::AVX2};
+
+std::vector<uint8_t> randomBytes(std::mt19937& rng, size_t count) {
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<uint8_t> bytes(count);
+    for (uint8_t& b : bytes) {
+        b = static_cast<uint8_t>(byte(rng));
+    }
+    return bytes;
+}
+
+// A printable ramp of the given length; lengths past 95 repeat characters,
+// which the converter must still index consistently.
+std::string palette(int length) {
+    std::string chars;
+    for (int i = 0; i < length; i++) {
+        chars += static_cast<char>(' ' + i % 95);
+    }
+    return chars;
+}
+
+// Copies a tightly packed plane into rows of stride bytes and fills the
+// padding with fill, so reads past a row's end change the output.
+std::vector<uint8_t> padRows(const std::vector<uint8_t>& plane, int row_bytes, int rows, int stride, uint8_t fill) {
+    std::vector<uint8_t> padded(static_cast<size_t>(stride) * rows, fill);
+    for (int y = 0; y < rows; y++) {
+        std::memcpy(&padded[static_cast<size_t>(y) * stride], &plane[static_cast<size_t>(y) * row_bytes], row_bytes);
+    }
+    return padded;
+}
+
+bool sameCells(const ColorAsciiFrame& a, const ColorAsciiFrame& b) {
+    const size_t cells = static_cast<size_t>(a.width) * a.height;
+    return a.width == b.width && a.height == b.height && std::memcmp(a.glyphs.data(), b.glyphs.data(), cells) == 0 &&
+           std::memcmp(a.red.data(), b.red.data(), cells) == 0 &&
+           std::memcmp(a.green.data(), b.green.data(), cells) == 0 &&
+           std::memcmp(a.blue.data(), b.blue.data(), cells) == 0;
+}
+
+// Copies the cells covered by delta's runs from current into target, the way
+// a consumer patches its copy of the previous frame. Returns false when a
+// run is empty, leaves the grid or does not start and end on a changed cell.
+bool applyRuns(const GlyphDelta& delta, const GlyphIndexFrame& current, GlyphIndexFrame& target) {
+    for (const CellRun& run : delta.runs) {
+        if (run.length <= 0 || run.x < 0 || run.x + run.length > current.width || run.y < 0 ||
+            run.y >= current.height) {
+            return false;
+        }
+        const int last = run.x + run.length - 1;
+        if (target.index(run.x, run.y) == current.index(run.x, run.y) ||
+            target.index(last, run.y) == current.index(last, run.y)) {
+            return false;
+        }
+        for (int x = run.x; x <= last; x++) {
+            uint8_t* row = target.row(run.y);
+            if (target.bits == 4) {
+                const int shift = (x & 1) * 4;
+                row[x / 2] = static_cast<uint8_t>((row[x / 2] & ~(0x0F << shift)) | (current.index(x, run.y) << shift));
+            } else {
+                row[x] = current.index(x, run.y);
+            }
+        }
+    }
+    return true;
+}
+
+bool sameCells(const GlyphIndexFrame& a, const GlyphIndexFrame& b) {
+    if (a.width != b.width || a.height != b.height || a.bits != b.bits) {
+        return false;
+    }
+    for (int y = 0; y < a.height; y++) {
+        for (int x = 0; x < a.width; x++) {
+            if (a.index(x, y) != b.index(x, y)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+#define FOR_EACH_VECTOR_ISA(isa)                     \
+    for (KernelIsa isa : kVectorIsas)                \
+        if (!kernelIsaSupported(isa)) {              \
+            continue;                                \
+        } else
+
+} // namespace
+
+TEST(LumaFixed, WithinOneLevelOfFloatFormula) {
+    for (int r = 0; r < 256; r += 3) {
+        for (int g = 0; g < 256; g += 5) {
+            for (int b = 0; b < 256; b++) {
+                const int exact = static_cast<int>(0.299 * r + 0.587 * g + 0.114 * b);
+                const int fixed = lumaFixed(r, g, b);
+                CHECK_EQ(true, std::abs(fixed - exact) <= 1, r << "," << g << "," << b);
+            }
+        }
+    }
+    CHECK_EQ(255, lumaFixed(255, 255, 255), "white");
+    CHECK_EQ(0, lumaFixed(0, 0, 0), "black");
+}
+
+TEST(Kernels, LumaRowMatchesScalar) {
+    std::mt19937 rng(1);
+    const LumaRowKernel scalar = lumaRowKernel(KernelIsa::Scalar);
+    for (int length : {1, 16, 17, 300}) {
+        GlyphTable table;
+        buildGlyphTable(table, palette(length));
+        for (int trial = 0; trial < 50; trial++) {
+            const int count = 1 + rng() % 97;
+            const int pixel_stride = 3 + rng() % 2;
+            const int src_width = count * (1 + rng() % 3);
+            const std::vector<uint8_t> src = randomBytes(rng, static_cast<size_t>(src_width) * pixel_stride + 4);
+            std::vector<int> offsets(count);
+            for (int i = 0; i < count; i++) {
+                offsets[i] = static_cast<int>(rng() % src_width) * pixel_stride;
+            }
+            // Only cells whose 4-byte load stays inside the row may be vectorised.
+            int vector_count = count;
+            while (vector_count > 0 && offsets[vector_count - 1] + 4 > src_width * pixel_stride) {
+                vector_count--;
+            }
+            const bool blue_first = rng() % 2;
+            std::string expected(count, '\0');
+            scalar(src.data(), offsets.data(), count, vector_count, blue_first, table, &expected[0]);
+            FOR_EACH_VECTOR_ISA(isa) {
+                std::string actual(count, '\0');
+                lumaRowKernel(isa)(src.data(), offsets.data(), count, vector_count, blue_first, table, &actual[0]);
+                CHECK_EQ(expected, actual, kernelIsaName(isa) << " palette " << length);
+            }
+        }
+    }
+}
+
+TEST(Kernels, AccumulateRowMatchesScalar) {
+    std::mt19937 rng(2);
+    for (int count : {1, 7, 15, 16, 17, 31, 33, 100, 257}) {
+        const std::vector<uint8_t> src = randomBytes(rng, count);
+        std::vector<uint16_t> expected(count, 100);
+        accumulateRowKernel(KernelIsa::Scalar)(src.data(), expected.data(), count);
+        FOR_EACH_VECTOR_ISA(isa) {
+            std::vector<uint16_t> actual(count, 100);
+            accumulateRowKernel(isa)(src.data(), actual.data(), count);
+            CHECK_EQ(expected, actual, kernelIsaName(isa) << " count " << count);
+        }
+    }
+}
+
+TEST(Kernels, ScanBytesMatchesScalar) {
+    std::mt19937 rng(3);
+    for (int trial = 0; trial < 200; trial++) {
+        const int count = 1 + rng() % 130;
+        std::vector<uint8_t> a = randomBytes(rng, count);
+        std::vector<uint8_t> b = a;
+        for (int i = 0; i < 3; i++) {
+            b[rng() % count] ^= 1;
+        }
+        const int begin = rng() % count;
+        for (bool find_different : {true, false}) {
+            const int expected = scanBytesKernel(KernelIsa::Scalar)(a.data(), b.data(), begin, count, find_different);
+            FOR_EACH_VECTOR_ISA(isa) {
+                const int actual = scanBytesKernel(isa)(a.data(), b.data(), begin, count, find_different);
+                CHECK_EQ(expected, actual, kernelIsaName(isa));
+            }
+        }
+    }
+}
+
+TEST(Kernels, SobelRowMatchesScalar) {
+    std::mt19937 rng(4);
+    for (int count : {1, 2, 7, 8, 9, 15, 16, 17, 33, 101}) {
+        const std::vector<uint8_t> rows = randomBytes(rng, count * 3);
+        std::vector<int16_t> gx(count);
+        std::vector<int16_t> gy(count);
+        sobelRowKernel(KernelIsa::Scalar)(rows.data(), rows.data() + count, rows.data() + 2 * count, count,
+                                          gx.data(), gy.data());
+        FOR_EACH_VECTOR_ISA(isa) {
+            std::vector<int16_t> actual_gx(count);
+            std::vector<int16_t> actual_gy(count);
+            sobelRowKernel(isa)(rows.data(), rows.data() + count, rows.data() + 2 * count, count,
+                                actual_gx.data(), actual_gy.data());
+            CHECK_EQ(gx, actual_gx, kernelIsaName(isa) << " count " << count);
+            CHECK_EQ(gy, actual_gy, kernelIsaName(isa) << " count " << count);
+        }
+    }
+}
+
+TEST(Kernels, ThresholdBitsMatchesScalar) {
+    std::mt19937 rng(5);
+    for (int count : {1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 64, 100}) {
+        const std::vector<uint8_t> src = randomBytes(rng, count);
+        const uint8_t threshold = static_cast<uint8_t>(rng());
+        const size_t bytes = (count + 7) / 8;
+        std::vector<uint8_t> expected(bytes);
+        thresholdBitsKernel(KernelIsa::Scalar)(src.data(), count, threshold, expected.data());
+        FOR_EACH_VECTOR_ISA(isa) {
+            std::vector<uint8_t> actual(bytes);
+            thresholdBitsKernel(isa)(src.data(), count, threshold, actual.data());
+            CHECK_EQ(expected, actual, kernelIsaName(isa) << " count " << count);
+        }
+    }
+}
+
+TEST(Kernels, DitherRowMatchesScalar) {
+    std::mt19937 rng(6);
+    for (int levels : {0, 1, 15, 16, 255}) {
+        for (int count : {1, 15, 16, 17, 33, 100}) {
+            const std::vector<uint8_t> gray = randomBytes(rng, count);
+            std::vector<uint8_t> bias = randomBytes(rng, count);
+            for (uint8_t& value : bias) {
+                value = value == 255 ? 254 : value;
+            }
+            std::vector<uint8_t> expected(count);
+            ditherRowKernel(KernelIsa::Scalar)(gray.data(), bias.data(), count, levels, expected.data());
+            FOR_EACH_VECTOR_ISA(isa) {
+                std::vector<uint8_t> actual(count);
+                ditherRowKernel(isa)(gray.data(), bias.data(), count, levels, actual.data());
+                CHECK_EQ(expected, actual, kernelIsaName(isa) << " levels " << levels);
+            }
+        }
+    }
+}
+
+TEST(Kernels, Rgb555LookupMatchesScalar) {
+    std::mt19937 rng(7);
+    const std::vector<uint8_t> lut = randomBytes(rng, 32768 + 3);
+    for (int count : {1, 7, 8, 9, 16, 17, 33, 100}) {
+        const std::vector<uint8_t> r = randomBytes(rng, count);
+        const std::vector<uint8_t> g = randomBytes(rng, count);
+        const std::vector<uint8_t> b = randomBytes(rng, count);
+        std::vector<uint8_t> expected(count);
+        rgb555LookupKernel(KernelIsa::Scalar)(r.data(), g.data(), b.data(), count, lut.data(), expected.data());
+        FOR_EACH_VECTOR_ISA(isa) {
+            std::vector<uint8_t> actual(count);
+            rgb555LookupKernel(isa)(r.data(), g.data(), b.data(), count, lut.data(), actual.data());
+            CHECK_EQ(expected, actual, kernelIsaName(isa) << " count " << count);
+        }
+    }
+}
+
+TEST(Frame, DiffGlyphIndicesMatchesScalar) {
+    std::mt19937 rng(10);
+    for (int bits : {4, 8}) {
+        for (int trial = 0; trial < 20; trial++) {
+            const int columns = 1 + rng() % 150;
+            const int rows = 1 + rng() % 20;
+            GlyphIndexFrame previous;
+            GlyphIndexFrame current;
+            previous.resize(columns, rows, bits);
+            current.resize(columns, rows, bits);
+            const std::vector<uint8_t> indices = randomBytes(rng, previous.indices.size());
+            std::memcpy(previous.indices.data(), indices.data(), indices.size());
+            std::memcpy(current.indices.data(), indices.data(), indices.size());
+            for (int i = 0; i < 10; i++) {
+                current.indices.data()[rng() % indices.size()] ^= 0x11;
+            }
+
+            GlyphDelta expected;
+            diffGlyphIndices(previous, current, expected, KernelIsa::Scalar);
+            FOR_EACH_VECTOR_ISA(isa) {
+                GlyphDelta actual;
+                diffGlyphIndices(previous, current, actual, isa);
+                CHECK_EQ(expected.runs.size(), actual.runs.size(), kernelIsaName(isa));
+                for (size_t i = 0; i < expected.runs.size(); i++) {
+                    CHECK_EQ(expected.runs[i].x, actual.runs[i].x, kernelIsaName(isa) << " run " << i);
+                    CHECK_EQ(expected.runs[i].y, actual.runs[i].y, kernelIsaName(isa) << " run " << i);
+                    CHECK_EQ(expected.runs[i].length, actual.runs[i].length, kernelIsaName(isa) << " run " << i);
+                }
+            }
+        }
+    }
+}
+
+// Patching the previous frame with the runs yields the current one, and in
+// 4-bit frames the runs are trimmed to the changed nibbles, including the
+// unused high nibble of odd-width rows.
+TEST(Frame, GlyphDeltaRunsRebuildCurrentFrame) {
+    std::mt19937 rng(14);
+    for (int bits : {4, 8}) {
+        for (int trial = 0; trial < 200; trial++) {
+            const int columns = 1 + rng() % 75;
+            const int rows = 1 + rng() % 6;
+            GlyphIndexFrame previous;
+            GlyphIndexFrame current;
+            previous.resize(columns, rows, bits);
+            current.resize(columns, rows, bits);
+            const std::vector<uint8_t> indices = randomBytes(rng, previous.indices.size());
+            std::memcpy(previous.indices.data(), indices.data(), indices.size());
+            std::memcpy(current.indices.data(), indices.data(), indices.size());
+            const int changes = rng() % 8;
+            for (int i = 0; i < changes; i++) {
+                // Single nibbles, so the trimming at both ends of a run is exercised.
+                current.indices.data()[rng() % indices.size()] ^= (rng() % 2 ? 0x0F : 0xF0);
+            }
+
+            GlyphDelta delta;
+            diffGlyphIndices(previous, current, delta, bestKernelIsa());
+            CHECK_EQ(false, delta.keyframe, "bits " << bits);
+            GlyphIndexFrame patched;
+            patched.resize(columns, rows, bits);
+            std::memcpy(patched.indices.data(), previous.indices.data(), indices.size());
+            CHECK_EQ(true, applyRuns(delta, current, patched), "bits " << bits << " trial " << trial);
+            CHECK_EQ(true, sameCells(current, patched), "bits " << bits << " trial " << trial);
+        }
+    }
+
+    GlyphIndexFrame previous;
+    GlyphIndexFrame current;
+    previous.resize(5, 1, 4);
+    current.resize(5, 1, 4);
+    std::memset(previous.indices.data(), 0, previous.indices.size());
+    std::memset(current.indices.data(), 0, current.indices.size());
+    current.row(0)[2] = 0xF0;    // padding nibble after the fifth cell
+    GlyphDelta delta;
+    diffGlyphIndices(previous, current, delta, bestKernelIsa());
+    CHECK_EQ(size_t(0), delta.runs.size(), "padding nibble only");
+
+    current.resize(5, 1, 8);
+    diffGlyphIndices(previous, current, delta, bestKernelIsa());
+    CHECK_EQ(true, delta.keyframe, "bit width change");
+    current.resize(6, 1, 4);
+    diffGlyphIndices(previous, current, delta, bestKernelIsa());
+    CHECK_EQ(true, delta.keyframe, "resize");
+}
+
+// The converter's deltas start with a keyframe, emit another on a resize or
+// a palette change that switches the index width, and otherwise patch the
+// previous output into the current one.
+TEST(Converter, GlyphDeltaKeyframesAndRuns) {
+    const int width = 97;
+    const int height = 61;
+    std::mt19937 rng(15);
+    std::vector<uint8_t> rgb = randomBytes(rng, static_cast<size_t>(width) * height * 3);
+    const VideoFrameView view = VideoFrameView::packedRGB(rgb.data(), width, height);
+
+    AsciiConverter converter(41, 20);
+    converter.setAsciiChars(palette(10));
+    GlyphIndexFrame previous;
+    GlyphIndexFrame current;
+    GlyphDelta delta;
+    converter.convertIndicesInto(view, previous, delta);
+    CHECK_EQ(true, delta.keyframe, "first frame");
+    CHECK_EQ(4, previous.bits, "short palette");
+
+    for (int frame = 0; frame < 6; frame++) {
+        for (int i = 0; i < 20; i++) {
+            rgb[rng() % rgb.size()] = static_cast<uint8_t>(rng());
+        }
+        converter.convertIndicesInto(view, current, delta);
+        CHECK_EQ(false, delta.keyframe, "frame " << frame);
+        CHECK_EQ(true, applyRuns(delta, current, previous), "frame " << frame);
+        CHECK_EQ(true, sameCells(current, previous), "frame " << frame);
+    }
+
+    converter.setOutputSize(40, 20);
+    converter.convertIndicesInto(view, current, delta);
+    CHECK_EQ(true, delta.keyframe, "resize");
+    converter.convertIndicesInto(view, current, delta);
+    CHECK_EQ(false, delta.keyframe, "after resize");
+    CHECK_EQ(size_t(0), delta.runs.size(), "unchanged frame");
+
+    converter.setAsciiChars(palette(17));
+    converter.convertIndicesInto(view, current, delta);
+    CHECK_EQ(8, current.bits, "long palette");
+    CHECK_EQ(true, delta.keyframe, "bit width change");
+}
+
+TEST(XtermPalette, QuantizeMatchesExhaustiveSearch) {
+    std::mt19937 rng(11);
+    ColorAsciiFrame frame;
+    frame.resize(317, 211);
+    const size_t cells = static_cast<size_t>(frame.width) * frame.height;
+    for (size_t i = 0; i < cells; i++) {
+        frame.red.data()[i] = static_cast<uint8_t>(rng());
+        frame.green.data()[i] = static_cast<uint8_t>(rng());
+        frame.blue.data()[i] = static_cast<uint8_t>(rng());
+    }
+    for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::SSE41, KernelIsa::AVX2}) {
+        if (!kernelIsaSupported(isa)) {
+            continue;
+        }
+        AlignedBuffer indices;
+        quantizeXterm256(frame, indices, isa);
+        for (size_t i = 0; i < cells; i++) {
+            const uint8_t r = frame.red.data()[i], g = frame.green.data()[i], b = frame.blue.data()[i];
+            CHECK_EQ(xterm256Nearest(r, g, b), indices.data()[i],
+                     kernelIsaName(isa) << " rgb " << int(r) << "," << int(g) << "," << int(b));
+        }
+    }
+}
+
+// Whole conversions through every ISA against the scalar converter, over
+// random source and grid sizes, odd widths and rows padded past width * bpp.
+TEST(Converter, EveryIsaMatchesScalar) {
+    std::mt19937 rng(8);
+    const PixelFormat formats[] = {PixelFormat::RGB, PixelFormat::BGR, PixelFormat::RGBx, PixelFormat::BGRA};
+    for (int length : {1, 16, 17, 300}) {
+        for (SamplingMode mode : {SamplingMode::Nearest, SamplingMode::Area}) {
+            for (int trial = 0; trial < 20; trial++) {
+                const PixelFormat format = formats[rng() % 4];
+                const int width = 1 + rng() % 333;
+                const int height = 1 + rng() % 200;
+                const int stride = width * pixelStride(format) + static_cast<int>(rng() % 3) * 13;
+                const std::vector<uint8_t> pixels = randomBytes(rng, static_cast<size_t>(stride) * height);
+                VideoFrameView frame;
+                frame.format = format;
+                frame.width = width;
+                frame.height = height;
+                frame.planes[0] = pixels.data();
+                frame.strides[0] = stride;
+
+                const int columns = 1 + rng() % 161;
+                const int rows = 1 + rng() % 61;
+                AsciiConverter scalar(columns, rows);
+                scalar.setAsciiChars(palette(length));
+                scalar.setSamplingMode(mode);
+                scalar.setKernelIsa(KernelIsa::Scalar);
+                AsciiFrame expected;
+                scalar.convertInto(frame, expected);
+
+                FOR_EACH_VECTOR_ISA(isa) {
+                    AsciiConverter converter(columns, rows);
+                    converter.setAsciiChars(palette(length));
+                    converter.setSamplingMode(mode);
+                    converter.setKernelIsa(isa);
+                    converter.setThreadCount(1 + rng() % 3);
+                    AsciiFrame actual;
+                    converter.convertInto(frame, actual);
+                    CHECK_EQ(expected.view(), actual.view(),
+                             kernelIsaName(isa) << " " << width << "x" << height << " stride " << stride << " -> "
+                                                << columns << "x" << rows << " palette " << length);
+                }
+            }
+        }
+    }
+}
+
+// I420 frames that differ only in the V plane stride must not share cached
+// sampling tables.
+TEST(Converter, I420VStrideIsPartOfGeometry) {
+    const int width = 64;
+    const int height = 48;
+    const int chroma_width = width / 2;
+    const int chroma_height = height / 2;
+    std::mt19937 rng(9);
+    const std::vector<uint8_t> luma = randomBytes(rng, width * height);
+    const std::vector<uint8_t> u = randomBytes(rng, chroma_width * chroma_height);
+    const std::vector<uint8_t> v = randomBytes(rng, chroma_width * chroma_height);
+    const int padded_stride = chroma_width + 16;
+    std::vector<uint8_t> padded_v(static_cast<size_t>(padded_stride) * chroma_height);
+    for (int y = 0; y < chroma_height; y++) {
+        std::memcpy(&padded_v[y * padded_stride], &v[y * chroma_width], chroma_width);
+    }
+
+    VideoFrameView frame;
+    frame.format = PixelFormat::I420;
+    frame.width = width;
+    frame.height = height;
+    frame.planes[0] = luma.data();
+    frame.planes[1] = u.data();
+    frame.planes[2] = v.data();
+    frame.strides[0] = width;
+    frame.strides[1] = chroma_width;
+    frame.strides[2] = chroma_width;
+    VideoFrameView padded = frame;
+    padded.planes[2] = padded_v.data();
+    padded.strides[2] = padded_stride;
+
+    for (SamplingMode mode : {SamplingMode::Nearest, SamplingMode::Area}) {
+        AsciiConverter converter(20, 10);
+        converter.setSamplingMode(mode);
+        ColorAsciiFrame expected;
+        ColorAsciiFrame actual;
+        converter.convertColorInto(frame, expected);
+        converter.convertColorInto(padded, actual);
+        const size_t cells = 20 * 10;
+        CHECK_EQ(0, std::memcmp(expected.blue.data(), actual.blue.data(), cells), "mode " << static_cast<int>(mode));
+        CHECK_EQ(0, std::memcmp(expected.red.data(), actual.red.data(), cells), "mode " << static_cast<int>(mode));
+    }
+}
+
+// The same picture as I420 and as NV12, at odd sizes and with padded rows,
+// samples to the same glyphs and colours.
+TEST(Converter, Nv12MatchesI420) {
+    std::mt19937 rng(11);
+    for (GridSize size : {GridSize{63, 47}, GridSize{17, 9}, GridSize{1, 1}}) {
+        const int chroma_width = (size.width + 1) / 2;
+        const int chroma_height = (size.height + 1) / 2;
+        const std::vector<uint8_t> luma = randomBytes(rng, static_cast<size_t>(size.width) * size.height);
+        const std::vector<uint8_t> u = randomBytes(rng, static_cast<size_t>(chroma_width) * chroma_height);
+        const std::vector<uint8_t> v = randomBytes(rng, static_cast<size_t>(chroma_width) * chroma_height);
+        std::vector<uint8_t> uv(u.size() * 2);
+        for (size_t i = 0; i < u.size(); i++) {
+            uv[i * 2] = u[i];
+            uv[i * 2 + 1] = v[i];
+        }
+        const std::vector<uint8_t> padded_luma = padRows(luma, size.width, size.height, size.width + 5, 0xff);
+        const std::vector<uint8_t> padded_u = padRows(u, chroma_width, chroma_height, chroma_width + 3, 0xff);
+        const std::vector<uint8_t> padded_v = padRows(v, chroma_width, chroma_height, chroma_width + 9, 0xff);
+        const std::vector<uint8_t> padded_uv = padRows(uv, chroma_width * 2, chroma_height, chroma_width * 2 + 7, 0xff);
+
+        VideoFrameView i420;
+        i420.format = PixelFormat::I420;
+        i420.width = size.width;
+        i420.height = size.height;
+        i420.planes[0] = padded_luma.data();
+        i420.planes[1] = padded_u.data();
+        i420.planes[2] = padded_v.data();
+        i420.strides[0] = size.width + 5;
+        i420.strides[1] = chroma_width + 3;
+        i420.strides[2] = chroma_width + 9;
+        VideoFrameView nv12 = i420;
+        nv12.format = PixelFormat::NV12;
+        nv12.planes[1] = padded_uv.data();
+        nv12.planes[2] = nullptr;
+        nv12.strides[1] = chroma_width * 2 + 7;
+        nv12.strides[2] = 0;
+
+        for (bool limited_range : {true, false}) {
+            i420.limited_range = nv12.limited_range = limited_range;
+            for (SamplingMode mode : {SamplingMode::Nearest, SamplingMode::Area}) {
+                AsciiConverter converter(13, 7);
+                converter.setSamplingMode(mode);
+                ColorAsciiFrame expected;
+                ColorAsciiFrame actual;
+                converter.convertColorInto(i420, expected);
+                converter.convertColorInto(nv12, actual);
+                CHECK_EQ(true, sameCells(expected, actual),
+                         size.width << "x" << size.height << " mode " << static_cast<int>(mode) << " limited "
+                                    << limited_range);
+            }
+        }
+    }
+}
+
+// Flat limited-range I420 expands to the full-range colour and glyph of the
+// same level, including the partial cells at the odd right and bottom edges;
+// the padding is filled with a far-off level so any read of it shows.
+TEST(Converter, LimitedRangeExpandsToFullRange) {
+    const int width = 63;
+    const int height = 47;
+    const int chroma_width = (width + 1) / 2;
+    const int chroma_height = (height + 1) / 2;
+    struct Level {
+        uint8_t y;
+        bool limited_range;
+        uint8_t full;
+    };
+    for (Level level : {Level{16, true, 0}, Level{235, true, 255}, Level{126, true, 128}, Level{126, false, 126},
+                        Level{8, true, 0}, Level{250, true, 255}}) {
+        const uint8_t fill = level.y < 128 ? 0xff : 0x00;
+        const std::vector<uint8_t> luma = padRows(std::vector<uint8_t>(width * height, level.y), width, height,
+                                                  width + 5, fill);
+        const std::vector<uint8_t> chroma = padRows(std::vector<uint8_t>(chroma_width * chroma_height, 128),
+                                                    chroma_width, chroma_height, chroma_width + 3, 0x00);
+        VideoFrameView i420;
+        i420.format = PixelFormat::I420;
+        i420.width = width;
+        i420.height = height;
+        i420.planes[0] = luma.data();
+        i420.planes[1] = chroma.data();
+        i420.planes[2] = chroma.data();
+        i420.strides[0] = width + 5;
+        i420.strides[1] = i420.strides[2] = chroma_width + 3;
+        i420.limited_range = level.limited_range;
+
+        const std::vector<uint8_t> gray(width * height, level.full);
+        VideoFrameView reference;
+        reference.format = PixelFormat::GRAY8;
+        reference.width = width;
+        reference.height = height;
+        reference.planes[0] = gray.data();
+        reference.strides[0] = width;
+
+        for (SamplingMode mode : {SamplingMode::Nearest, SamplingMode::Area}) {
+            AsciiConverter converter(13, 7);
+            converter.setSamplingMode(mode);
+            ColorAsciiFrame expected;
+            ColorAsciiFrame actual;
+            converter.convertColorInto(reference, expected);
+            converter.convertColorInto(i420, actual);
+            CHECK_EQ(level.full, actual.red.data()[0], "Y " << int(level.y) << " mode " << static_cast<int>(mode));
+            CHECK_EQ(true, sameCells(expected, actual),
+                     "Y " << int(level.y) << " limited " << level.limited_range << " mode "
+                          << static_cast<int>(mode));
+
+            AsciiFrame expected_text;
+            AsciiFrame actual_text;
+            converter.convertInto(reference, expected_text);
+            converter.convertInto(i420, actual_text);
+            CHECK_EQ(expected_text.view(), actual_text.view(), "Y " << int(level.y) << " mode " << static_cast<int>(mode));
+        }
+    }
+}
+
+// GRAY8 samples like the packed RGB frame with the same level in every
+// channel, at odd sizes and with padded rows.
+TEST(Converter, Gray8MatchesEquivalentRgb) {
+    std::mt19937 rng(12);
+    for (GridSize size : {GridSize{63, 47}, GridSize{17, 9}, GridSize{1, 1}}) {
+        const std::vector<uint8_t> gray = randomBytes(rng, static_cast<size_t>(size.width) * size.height);
+        std::vector<uint8_t> rgb(gray.size() * 3);
+        for (size_t i = 0; i < gray.size(); i++) {
+            rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = gray[i];
+        }
+        const std::vector<uint8_t> padded_gray = padRows(gray, size.width, size.height, size.width + 3, 0xff);
+        const std::vector<uint8_t> padded_rgb = padRows(rgb, size.width * 3, size.height, size.width * 3 + 11, 0x00);
+
+        VideoFrameView gray_frame;
+        gray_frame.format = PixelFormat::GRAY8;
+        gray_frame.width = size.width;
+        gray_frame.height = size.height;
+        gray_frame.planes[0] = padded_gray.data();
+        gray_frame.strides[0] = size.width + 3;
+        VideoFrameView rgb_frame = VideoFrameView::packedRGB(padded_rgb.data(), size.width, size.height);
+        rgb_frame.strides[0] = size.width * 3 + 11;
+
+        for (SamplingMode mode : {SamplingMode::Nearest, SamplingMode::Area}) {
+            AsciiConverter converter(13, 7);
+            converter.setSamplingMode(mode);
+            ColorAsciiFrame expected;
+            ColorAsciiFrame actual;
+            converter.convertColorInto(rgb_frame, expected);
+            converter.convertColorInto(gray_frame, actual);
+            CHECK_EQ(true, sameCells(expected, actual),
+                     size.width << "x" << size.height << " mode " << static_cast<int>(mode));
+
+            AsciiFrame expected_text;
+            AsciiFrame actual_text;
+            converter.convertInto(rgb_frame, expected_text);
+            converter.convertInto(gray_frame, actual_text);
+            CHECK_EQ(expected_text.view(), actual_text.view(),
+                     size.width << "x" << size.height << " mode " << static_cast<int>(mode));
+        }
+    }
+}
+
+// With cells at most 4x4 pixels every pixel is a signature probe, so change
+// detection must reproduce full conversion exactly, frame after frame.
+TEST(Converter, ChangeDetectionMatchesFullConversion) {
+    const int width = 97;
+    const int height = 61;
+    for (int length : {10, 17, 300}) {
+        for (SamplingMode mode : {SamplingMode::Nearest, SamplingMode::Area}) {
+            for (int threads : {1, 3}) {
+                std::mt19937 rng(13);
+                std::vector<uint8_t> rgb = randomBytes(rng, static_cast<size_t>(width) * height * 3);
+                AsciiConverter full(40, 20);
+                AsciiConverter tracked(40, 20);
+                for (AsciiConverter* converter : {&full, &tracked}) {
+                    converter->setAsciiChars(palette(length));
+                    converter->setSamplingMode(mode);
+                    converter->setThreadCount(threads);
+                }
+                tracked.setChangeDetection(true, 1000);
+
+                float min_dirty = 1.0f;
+                for (int frame = 0; frame < 12; frame++) {
+                    // Mostly a few changed pixels, every fourth frame a third of them.
+                    const size_t changes = frame % 4 == 3 ? rgb.size() / 3 : 5;
+                    for (size_t i = 0; i < changes; i++) {
+                        rgb[rng() % rgb.size()] = static_cast<uint8_t>(rng());
+                    }
+                    const VideoFrameView view = VideoFrameView::packedRGB(rgb.data(), width, height);
+                    AsciiFrame expected;
+                    AsciiFrame actual;
+                    full.convertInto(view, expected);
+                    tracked.convertInto(view, actual);
+                    min_dirty = std::min(min_dirty, tracked.getDirtyFraction());
+                    CHECK_EQ(expected.view(), actual.view(),
+                             "palette " << length << " mode " << static_cast<int>(mode) << " threads " << threads
+                                        << " frame " << frame);
+
+                    GlyphIndexFrame expected_indices;
+                    GlyphIndexFrame actual_indices;
+                    full.convertIndicesInto(view, expected_indices);
+                    tracked.convertIndicesInto(view, actual_indices);
+                    CHECK_EQ(0, std::memcmp(expected_indices.indices.data(), actual_indices.indices.data(),
+                                            expected_indices.indices.size()),
+                             "indices, palette " << length << " mode " << static_cast<int>(mode) << " threads "
+                                                 << threads << " frame " << frame);
+                }
+                // Only area sampling with a byte-indexed palette is tracked.
+                const bool tracking = mode == SamplingMode::Area && length <= 256;
+                CHECK_EQ(tracking, min_dirty < 1.0f,
+                         "palette " << length << " mode " << static_cast<int>(mode) << " threads " << threads);
+            }
+        }
+    }
+}
+
+std::string utf8(unsigned code_point) {
+    std::string s;
+    s += static_cast<char>(0xE0 | (code_point >> 12));
+    s += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    s += static_cast<char>(0x80 | (code_point & 0x3F));
+    return s;
+}
+
+// One cell per Braille pattern, from a source of exactly 2x4 pixels per cell
+// so every dot reads one pixel: bit n - 1 of the code point offset is dot n,
+// which sits at (column, row) dot_positions[n - 1].
+TEST(Converter, BrailleDotsFollowUnicodeOrder) {
+    const int dot_positions[8][2] = {{0, 0}, {0, 1}, {0, 2}, {1, 0}, {1, 1}, {1, 2}, {0, 3}, {1, 3}};
+    const int cells = 256;
+    const int width = cells * 2;
+    const int height = 4;
+    std::vector<uint8_t> gray(width * height, 0);
+    std::string expected;
+    for (int pattern = 0; pattern < cells; pattern++) {
+        for (int dot = 0; dot < 8; dot++) {
+            if (pattern & (1 << dot)) {
+                gray[dot_positions[dot][1] * width + pattern * 2 + dot_positions[dot][0]] = 255;
+            }
+        }
+        expected += utf8(0x2800 + pattern);
+    }
+    expected += '\n';
+    std::vector<uint8_t> rgb(gray.size() * 3);
+    for (size_t i = 0; i < gray.size(); i++) {
+        rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = gray[i];
+    }
+
+    VideoFrameView gray_frame;
+    gray_frame.format = PixelFormat::GRAY8;
+    gray_frame.width = width;
+    gray_frame.height = height;
+    gray_frame.planes[0] = gray.data();
+    gray_frame.strides[0] = width;
+    for (const VideoFrameView& frame : {gray_frame, VideoFrameView::packedRGB(rgb.data(), width, height)}) {
+        for (KernelIsa isa : {KernelIsa::Scalar, KernelIsa::SSE41, KernelIsa::AVX2}) {
+            AsciiConverter converter(cells, 1);
+            if (!converter.setKernelIsa(isa)) {
+                continue;
+            }
+            Utf8Frame out;
+            converter.convertUtf8Into(frame, Utf8Mode::Braille, out);
+            CHECK_EQ(expected, std::string(out.view()),
+                     kernelIsaName(isa) << " format " << static_cast<int>(frame.format));
+        }
+    }
+}
+
+// Half blocks light a half when the mean of its 2x2 dots is strictly above
+// the threshold: space, upper half, lower half or full block.
+TEST(Converter, HalfBlocksFollowHalfMeans) {
+    // Per cell, the lit dots of the top and bottom half (4 bits each, row-major).
+    const int halves[][2] = {{0x0, 0x0}, {0xF, 0x0}, {0x0, 0xF}, {0xF, 0xF}, {0x3, 0x9}};
+    const int cells = 5;
+    const int width = cells * 2;
+    const int height = 4;
+    std::vector<uint8_t> gray(width * height, 0);
+    for (int cell = 0; cell < cells; cell++) {
+        for (int half = 0; half < 2; half++) {
+            for (int dot = 0; dot < 4; dot++) {
+                if (halves[cell][half] & (1 << dot)) {
+                    gray[(half * 2 + dot / 2) * width + cell * 2 + dot % 2] = 255;
+                }
+            }
+        }
+    }
+    VideoFrameView frame;
+    frame.format = PixelFormat::GRAY8;
+    frame.width = width;
+    frame.height = height;
+    frame.planes[0] = gray.data();
+    frame.strides[0] = width;
+
+    // The last cell has two of four dots lit in each half, a mean of 128.
+    const std::string blocks = " " + utf8(0x2580) + utf8(0x2584) + utf8(0x2588);
+    AsciiConverter converter(cells, 1);
+    Utf8Frame out;
+    converter.setDotThreshold(128);
+    converter.convertUtf8Into(frame, Utf8Mode::HalfBlock, out);
+    CHECK_EQ(blocks + " \n", std::string(out.view()), "threshold 128");
+    converter.setDotThreshold(127);
+    converter.convertUtf8Into(frame, Utf8Mode::HalfBlock, out);
+    CHECK_EQ(blocks + utf8(0x2588) + "\n", std::string(out.view()), "threshold 127");
+}
+
+// After a full-range scene, a low-contrast ramp must come to span the whole
+// palette, even with a requested smoothing of 0.
+TEST(Converter, AutoContrastStretchesLowContrastRamp) {
+    const int width = 256;
+    const int height = 8;
+    std::vector<uint8_t> full(width * height);
+    std::vector<uint8_t> flat(width * height);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            full[y * width + x] = static_cast<uint8_t>(x);
+            flat[y * width + x] = static_cast<uint8_t>(96 + x / 4);
+        }
+    }
+    VideoFrameView frame;
+    frame.format = PixelFormat::GRAY8;
+    frame.width = width;
+    frame.height = height;
+    frame.strides[0] = width;
+
+    const std::string chars = " .:-=+*#%@";
+    for (float smoothing : {0.0f, 0.1f, 1.0f}) {
+        AsciiConverter converter(64, 4);
+        converter.setAsciiChars(chars);
+        converter.setAutoContrast(true, smoothing);
+        AsciiFrame out;
+        frame.planes[0] = full.data();
+        converter.convertInto(frame, out);
+
+        frame.planes[0] = flat.data();
+        converter.convertInto(frame, out);
+        if (smoothing < 1.0f) {
+            CHECK_EQ(true, out.view()[0] != chars.front() || out.view()[63] != chars.back(),
+                     "smoothing " << smoothing << " adapted within one frame");
+        }
+        for (int i = 0; i < 1000; i++) {
+            converter.convertInto(frame, out);
+        }
+        CHECK_EQ(chars.front(), out.view()[0], "smoothing " << smoothing);
+        CHECK_EQ(chars.back(), out.view()[63], "smoothing " << smoothing);
+    }
+}
+
+// Flat grey 128 sits 0.52 of the way from '=' (index 4 of 9 steps) to '+':
+// dithered, every 8x8 tile holds 33 '+' and 31 '='; plain, it is all '='.
+// Turning dithering off again restores the plain output exactly.
+TEST(Converter, DitheringMixesNeighbouringGlyphs) {
+    const std::string chars = " .:-=+*#%@";
+    std::vector<uint8_t> grey(256 * 64, 128);
+    VideoFrameView frame;
+    frame.format = PixelFormat::GRAY8;
+    frame.width = 256;
+    frame.height = 64;
+    frame.planes[0] = grey.data();
+    frame.strides[0] = 256;
+
+    for (SamplingMode mode : {SamplingMode::Nearest, SamplingMode::Area}) {
+        AsciiConverter converter(64, 16);
+        converter.setAsciiChars(chars);
+        converter.setSamplingMode(mode);
+        converter.setDithering(true);
+        AsciiFrame out;
+        converter.convertInto(frame, out);
+        const std::string_view text = out.view();
+        const size_t lower = std::count(text.begin(), text.end(), '=');
+        const size_t upper = std::count(text.begin(), text.end(), '+');
+        CHECK_EQ(size_t(16 * 31), lower, "mode " << static_cast<int>(mode));
+        CHECK_EQ(size_t(16 * 33), upper, "mode " << static_cast<int>(mode));
+
+        converter.setDithering(false);
+        converter.convertInto(frame, out);
+        CHECK_EQ(size_t(64 * 16), static_cast<size_t>(std::count(out.view().begin(), out.view().end(), '=')),
+                 "mode " << static_cast<int>(mode));
+    }
+
+    std::mt19937 rng(16);
+    const std::vector<uint8_t> rgb = randomBytes(rng, 160 * 120 * 3);
+    const VideoFrameView random = VideoFrameView::packedRGB(rgb.data(), 160, 120);
+    for (SamplingMode mode : {SamplingMode::Nearest, SamplingMode::Area}) {
+        AsciiConverter plain(40, 20);
+        AsciiConverter toggled(40, 20);
+        plain.setSamplingMode(mode);
+        toggled.setSamplingMode(mode);
+        AsciiFrame expected;
+        AsciiFrame actual;
+        plain.convertInto(random, expected);
+        toggled.setDithering(true);
+        toggled.convertInto(random, actual);
+        toggled.setDithering(false);
+        toggled.convertInto(random, actual);
+        CHECK_EQ(expected.view(), actual.view(), "mode " << static_cast<int>(mode));
+    }
+}
+
+// A thin vertical stroke one column either side of the glyph's own must
+// still read as '|'.
+TEST(Converter, ShapeModeToleratesOneColumnShift) {
+    for (int left : {2, 3, 4}) {
+        std::vector<uint8_t> gray(kGlyphWidth * kGlyphHeight, 0);
+        for (int y = 1; y < kGlyphHeight - 1; y++) {
+            gray[y * kGlyphWidth + left] = 255;
+            gray[y * kGlyphWidth + left + 1] = 255;
+        }
+        VideoFrameView frame;
+        frame.format = PixelFormat::GRAY8;
+        frame.width = kGlyphWidth;
+        frame.height = kGlyphHeight;
+        frame.planes[0] = gray.data();
+        frame.strides[0] = kGlyphWidth;
+
+        AsciiConverter converter(1, 1);
+        converter.setAsciiChars(" .:-=+*#%@|/\\");
+        converter.setGlyphMode(GlyphMode::Shape);
+        AsciiFrame out;
+        converter.convertInto(frame, out);
+        CHECK_EQ('|', out.view()[0], "stroke at columns " << left << "-" << left + 1);
+    }
+}
+
+// Geometries and pools the setters prepare for the last frame layout give
+// the same output as a converter configured from scratch, also when the
+// next frame has a different layout after all.
+TEST(Converter, PreparedSettingsMatchFreshConverter) {
+    std::mt19937 rng(17);
+    const std::vector<uint8_t> rgb = randomBytes(rng, 200 * 150 * 3);
+    const VideoFrameView large = VideoFrameView::packedRGB(rgb.data(), 200, 150);
+    const VideoFrameView small = VideoFrameView::packedRGB(rgb.data(), 120, 90);
+    for (SamplingMode mode : {SamplingMode::Nearest, SamplingMode::Area}) {
+        AsciiConverter converter(40, 20);
+        converter.setSamplingMode(mode);
+        AsciiFrame actual;
+        converter.convertInto(large, actual);
+
+        struct Step {
+            int columns;
+            int rows;
+            int threads;
+            const VideoFrameView* frame;
+        };
+        for (Step step : {Step{57, 31, 3, &large}, Step{57, 31, 1, &large}, Step{30, 12, 2, &small},
+                          Step{64, 40, 4, &small}}) {
+            converter.setOutputSize(step.columns, step.rows);
+            converter.setThreadCount(step.threads);
+            converter.convertInto(*step.frame, actual);
+
+            AsciiConverter fresh(step.columns, step.rows);
+            fresh.setSamplingMode(mode);
+            AsciiFrame expected;
+            fresh.convertInto(*step.frame, expected);
+            CHECK_EQ(expected.view(), actual.view(),
+                     step.columns << "x" << step.rows << " threads " << step.threads << " mode "
+                                  << static_cast<int>(mode));
+            CHECK_EQ(step.threads, converter.getActiveKernels().threads, "active threads");
+        }
+    }
+}
+
+// Autotuning replaces the kernels the conversions use without touching the
+// requested settings the getters report.
+TEST(Converter, AutotuneKeepsRequestedSettings) {
+    std::vector<uint8_t> rgb(320 * 240 * 3, 100);
+    AsciiConverter converter(40, 20);
+    converter.setKernelIsa(KernelIsa::Scalar);
+    converter.setAutotune(true);
+    AsciiFrame out;
+    converter.convertInto(VideoFrameView::packedRGB(rgb.data(), 320, 240), out);
+    const KernelChoice active = converter.getActiveKernels();
+    CHECK_EQ(true, kernelIsaSupported(active.isa), kernelIsaName(active.isa));
+    CHECK_EQ(true, active.threads >= 1, active.threads);
+    CHECK_EQ(KernelIsa::Scalar, converter.getKernelIsa(), "requested isa");
+    CHECK_EQ(1, converter.getThreadCount(), "requested threads");
+}
+
+// The first frame of a new geometry converts with the requested kernels
+// while tuning runs in the background on a copy of it; a later frame adopts
+// the choice the run saved. The caller's buffer is freed right after the
+// first frame, which a sanitizer build would flag if the run still read it.
+TEST(Converter, AutotuneRunsInBackground) {
+    char dir_template[] = "/tmp/autotune_XXXXXX";
+    const char* dir = mkdtemp(dir_template);
+    CHECK_EQ(true, dir != nullptr, "mkdtemp");
+    const std::string path = std::string(dir) + "/tune.txt";
+
+    std::mt19937 rng(18);
+    const std::vector<uint8_t> rgb = randomBytes(rng, 320 * 240 * 3);
+    AsciiConverter plain(40, 20);
+    AsciiFrame expected;
+    plain.convertInto(VideoFrameView::packedRGB(rgb.data(), 320, 240), expected);
+
+    AsciiConverter converter(40, 20);
+    converter.setKernelIsa(KernelIsa::Scalar);
+    converter.setAutotune(true, path);
+    AsciiFrame out;
+    {
+        const std::vector<uint8_t> first = rgb;
+        converter.convertInto(VideoFrameView::packedRGB(first.data(), 320, 240), out);
+    }
+    CHECK_EQ(KernelIsa::Scalar, converter.getActiveKernels().isa, "first frame");
+    CHECK_EQ(1, converter.getActiveKernels().threads, "first frame");
+    CHECK_EQ(expected.view(), out.view(), "first frame");
+
+    KernelChoice saved{KernelIsa::Scalar, 0};
+    for (int frame = 0; frame < 2000; frame++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        converter.convertInto(VideoFrameView::packedRGB(rgb.data(), 320, 240), out);
+        CHECK_EQ(expected.view(), out.view(), "frame " << frame);
+        std::ifstream file(path);
+        std::string key;
+        std::string isa_name;
+        if (file >> key >> isa_name >> saved.threads && kernelIsaFromName(isa_name, saved.isa) &&
+            converter.getActiveKernels().isa == saved.isa &&
+            converter.getActiveKernels().threads == saved.threads) {
+            break;
+        }
+        saved.threads = 0;
+    }
+    CHECK_EQ(true, saved.threads > 0, "tuned choice saved and adopted");
+    std::remove(path.c_str());
+    rmdir(dir);
+}
+
+TEST(Converter, PyramidRejectsSizesLargerThanGrid) {
+    std::vector<uint8_t> rgb(160 * 120 * 3);
+    for (size_t i = 0; i < rgb.size(); i++) {
+        rgb[i] = static_cast<uint8_t>(i * 7);
+    }
+    const VideoFrameView frame = VideoFrameView::packedRGB(rgb.data(), 160, 120);
+    AsciiConverter converter(40, 20);
+    converter.setSamplingMode(SamplingMode::Area);
+    std::vector<AsciiFrame> levels;
+    CHECK_EQ(false, converter.convertPyramidInto(frame, {{40, 20}, {80, 10}}, levels), "wider than grid");
+    CHECK_EQ(false, converter.convertPyramidInto(frame, {{20, 21}}, levels), "taller than grid");
+    CHECK_EQ(true, converter.convertPyramidInto(frame, {{40, 20}, {20, 10}, {0, 5}}, levels), "within grid");
+    CHECK_EQ(size_t(3), levels.size(), "levels");
+
+    AsciiFrame full;
+    converter.convertInto(frame, full);
+    CHECK_EQ(full.view(), levels[0].view(), "full-size level");
+    CHECK_EQ(20, levels[1].width, "half width");
+    CHECK_EQ(10, levels[1].height, "half height");
+    CHECK_EQ(0, levels[2].width, "empty level");
+}
+
+// Caches sharing a file, as separate processes would, keep each other's
+// entries and never leave temporary files behind, even when storing at once.
+TEST(KernelTuneCache, SharedFileKeepsEveryWritersEntries) {
+    char dir_template[] = "/tmp/kernel_tune_cache_XXXXXX";
+    const char* dir = mkdtemp(dir_template);
+    CHECK_EQ(true, dir != nullptr, "mkdtemp");
+    const std::string path = std::string(dir) + "/tune.txt";
+
+    KernelTuneCache first(path);
+    KernelTuneCache second(path);
+    CHECK_EQ(true, first.store("a", {KernelIsa::Scalar, 1}), "first store");
+    CHECK_EQ(true, second.store("b", {KernelIsa::Scalar, 2}), "second store");
+    KernelChoice choice{};
+    CHECK_EQ(true, KernelTuneCache(path).lookup("a", choice), "first entry kept");
+    CHECK_EQ(true, KernelTuneCache(path).lookup("b", choice), "second entry");
+    CHECK_EQ(2, choice.threads, "second entry");
+
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 4; w++) {
+        writers.emplace_back([&path, w]() {
+            KernelTuneCache cache(path);
+            for (int i = 0; i < 50; i++) {
+                cache.store("w" + std::to_string(w) + "_" + std::to_string(i), {KernelIsa::Scalar, 1 + w});
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    // Every writer loaded the file after "a" was stored, so no rewrite drops it.
+    const KernelTuneCache merged(path);
+    CHECK_EQ(true, merged.lookup("a", choice), "entry from before the writers");
+    int files = 0;
+    DIR* listing = opendir(dir);
+    while (dirent* entry = readdir(listing)) {
+        files += entry->d_name[0] != '.';
+    }
+    closedir(listing);
+    CHECK_EQ(1, files, "files left in " << dir);
+    std::remove(path.c_str());
+    rmdir(dir);
+}
+
+int main() {
+    return runTests();
+}
@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gst/gst.h>
+#include "ascii_converter.h"
+#include "gstreamer_pipeline.h"
+#include "test_harness.h"
+
+namespace {
+
+// ctest reports this exit code as skipped.
+const int kSkipped = 77;
+
+// Elements from gst-plugins-base that the tests' pipelines are built from.
+const char* const kRequiredElements[] = {"videotestsrc", "videoscale", "videoconvert", "appsink"};
+
+bool haveRequiredElements() {
+    for (const char* name : kRequiredElements) {
+        GstElementFactory* factory = gst_element_factory_find(name);
+        if (!factory) {
+            std::printf("skipped: GStreamer element %s not found\n", name);
+            return false;
+        }
+        gst_object_unref(factory);
+    }
+    return true;
+}
+
+// Polls until done() holds or timeout passes.
+template <typename Done>
+bool waitFor(Done done, std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+// A stop() that never returns would hang the run, so it is timed on another
+// thread and a hang exits the test binary.
+void stopOrExit(GStreamerPipeline& pipeline) {
+    std::future<void> stopped = std::async(std::launch::async, [&pipeline] { pipeline.stop(); });
+    if (stopped.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+        std::fprintf(stderr, "GStreamerPipeline::stop() did not return within 5 s\n");
+        std::_Exit(EXIT_FAILURE);
+    }
+}
+
+// Starts pipeline, waits for its first frame and stops it again.
+bool firstFrame(GStreamerPipeline& pipeline, VideoFrameHandle& frame) {
+    std::mutex first_mutex;
+    VideoFrameHandle first;
+    pipeline.setFrameHandleCallback([&](const VideoFrameHandle& handle) {
+        std::lock_guard<std::mutex> lock(first_mutex);
+        if (!first) {
+            first = handle;
+        }
+    });
+    if (!pipeline.start()) {
+        return false;
+    }
+    const bool arrived = waitFor(
+        [&] {
+            std::lock_guard<std::mutex> lock(first_mutex);
+            return static_cast<bool>(first);
+        },
+        std::chrono::seconds(5));
+    stopOrExit(pipeline);
+    frame = first;
+    return arrived;
+}
+
+// Counts the QoS events passing pad on their way upstream.
+GstPadProbeReturn countQosEvents(GstPad* pad, GstPadProbeInfo* info, gpointer user_data) {
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) == GST_EVENT_QOS) {
+        static_cast<std::atomic<int>*>(user_data)->fetch_add(1);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+// Hashes the visible bytes of plane 0, which carries luma or packed RGB.
+uint64_t planeChecksum(const VideoFrameView& frame) {
+    uint64_t hash = 14695981039346656037ull;
+    const int row_bytes = frame.width * pixelStride(frame.format);
+    for (int y = 0; y < frame.height; y++) {
+        const uint8_t* row = frame.planes[0] + static_cast<size_t>(y) * frame.strides[0];
+        for (int x = 0; x < row_bytes; x++) {
+            hash = (hash ^ row[x]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+}  // namespace
+
+// The source outpaces the callback, so samples are queued in appsink, or
+// blocked behind the streaming thread, when stop() is called. The converter
+// is destroyed as soon as stop() returns; a callback after that would both
+// be counted and, under ASan, report a use after free.
+TEST(Pipeline, StopWaitsForCallbacks) {
+    for (size_t queue_depth : {size_t(0), size_t(2)}) {
+        auto converter = std::make_unique<AsciiConverter>(16, 8);
+        GlyphIndexFrame converted;
+        std::atomic<bool> stopped(false);
+        std::atomic<int> calls(0);
+        std::atomic<int> late_calls(0);
+
+        GStreamerPipeline pipeline;
+        CHECK_EQ(true, pipeline.setWorkerQueue(queue_depth), "queue depth " << queue_depth);
+        CHECK_EQ(true,
+                 pipeline.initializeForGrid("videotestsrc is-live=true ! video/x-raw,framerate=100/1",
+                                            converter->getOutputWidth(), converter->getOutputHeight()),
+                 "queue depth " << queue_depth);
+        pipeline.setFrameCallback([&](const VideoFrameView& frame) {
+            if (stopped.load()) {
+                late_calls++;
+                return;
+            }
+            converter->convertIndicesInto(frame, converted);
+            std::this_thread::sleep_for(std::chrono::milliseconds(30));
+            calls++;
+        });
+
+        CHECK_EQ(true, pipeline.start(), "queue depth " << queue_depth);
+        CHECK_EQ(true, waitFor([&] { return calls.load() >= 3; }, std::chrono::seconds(5)),
+                 "queue depth " << queue_depth << ", " << calls.load() << " callbacks");
+        stopOrExit(pipeline);
+        stopped = true;
+        converter.reset();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        CHECK_EQ(0, late_calls.load(), "queue depth " << queue_depth);
+    }
+}
+
+// Handles are kept across many later pulls, past stop() and past the
+// pipeline itself. Each must still be mapped and show the pixels it had in
+// the callback; a buffer unmapped early or recycled by the pool while held
+// changes its checksum, and under ASan reading it is reported.
+TEST(Pipeline, HandlesOutliveLaterPulls) {
+    struct KeptFrame {
+        VideoFrameHandle handle;
+        uint64_t checksum;
+    };
+    std::mutex kept_mutex;
+    std::vector<KeptFrame> kept;
+
+    {
+        GStreamerPipeline pipeline;
+        CHECK_EQ(true, pipeline.setWorkerQueue(2), "");
+        CHECK_EQ(true,
+                 pipeline.initializeForGrid("videotestsrc pattern=ball ! video/x-raw,framerate=100/1", 32, 16),
+                 "");
+        pipeline.setFrameHandleCallback([&](const VideoFrameHandle& handle) {
+            std::lock_guard<std::mutex> lock(kept_mutex);
+            if (kept.size() < 20) {
+                kept.push_back({handle, planeChecksum(handle.view())});
+            }
+        });
+
+        CHECK_EQ(true, pipeline.start(), "");
+        CHECK_EQ(true,
+                 waitFor(
+                     [&] {
+                         std::lock_guard<std::mutex> lock(kept_mutex);
+                         return kept.size() == 20;
+                     },
+                     std::chrono::seconds(5)),
+                 kept.size() << " frames kept");
+        stopOrExit(pipeline);
+    }
+
+    size_t distinct = 0;
+    for (size_t i = 0; i < kept.size(); i++) {
+        const VideoFrameHandle& handle = kept[i].handle;
+        CHECK_EQ(true, static_cast<bool>(handle), "frame " << i);
+        CHECK_EQ(true, handle.sample() != nullptr, "frame " << i);
+        CHECK_EQ(handle.view().width, GST_VIDEO_INFO_WIDTH(handle.info()), "frame " << i);
+        CHECK_EQ(kept[i].checksum, planeChecksum(handle.view()), "frame " << i);
+        distinct += i == 0 || kept[i].checksum != kept[i - 1].checksum;
+    }
+    // The ball moves, so consecutive frames differ; identical checksums would
+    // mean the handles share one buffer.
+    CHECK_EQ(true, distinct > kept.size() / 2, distinct << " distinct of " << kept.size());
+}
+
+// The source's own size and aspect ratio are scaled away: appsink gets
+// multiple pixels per cell, in a format the converter reads.
+TEST(Pipeline, GridFramesMatchGrid) {
+    for (int multiple : {0, 1, 2, 3}) {
+        const int expected_multiple = std::max(multiple, 1);
+        GStreamerPipeline pipeline;
+        CHECK_EQ(true,
+                 pipeline.initializeForGrid("videotestsrc ! video/x-raw,width=320,height=240,framerate=100/1", 16,
+                                            8, multiple),
+                 "multiple " << multiple);
+        VideoFrameHandle frame;
+        CHECK_EQ(true, firstFrame(pipeline, frame), "multiple " << multiple);
+        CHECK_EQ(16 * expected_multiple, frame.view().width, "multiple " << multiple);
+        CHECK_EQ(8 * expected_multiple, frame.view().height, "multiple " << multiple);
+
+        AsciiConverter converter(16, 8);
+        converter.setSamplingMode(SamplingMode::Area);
+        GlyphIndexFrame converted;
+        converter.convertIndicesInto(frame.view(), converted);
+        CHECK_EQ(16, converted.width, "multiple " << multiple);
+        CHECK_EQ(8, converted.height, "multiple " << multiple);
+    }
+}
+
+// The default pipeline exactly as README.md shows it; keep the two in sync.
+TEST(Pipeline, ReadmeDefaultPipelineRuns) {
+    GStreamerPipeline pipeline;
+    CHECK_EQ(true,
+             pipeline.initialize("videotestsrc pattern=ball ! video/x-raw,framerate=30/1 ! videoscale ! "
+                                 "video/x-raw,width=256,height=128 ! videoconvert ! appsink name=appsink"),
+             "");
+    VideoFrameHandle frame;
+    CHECK_EQ(true, firstFrame(pipeline, frame), "");
+    CHECK_EQ(256, frame.view().width, "");
+    CHECK_EQ(128, frame.view().height, "");
+}
+
+// A callback three frame durations long keeps the pipeline overloaded, so
+// late samples are dropped unmapped and QoS events must travel through
+// videoconvert and videoscale to the source. Appsink's own QoS is off, so
+// every event counted was sent by the pipeline.
+TEST(Pipeline, QosEventsReachSource) {
+    std::atomic<int> qos_events(0);
+    GStreamerPipeline pipeline;
+    CHECK_EQ(true,
+             pipeline.initializeForGrid("videotestsrc is-live=true name=source ! video/x-raw,framerate=100/1", 16, 8),
+             "");
+
+    GstElement* appsink = pipeline.getElement("appsink");
+    CHECK_EQ(true, appsink != nullptr, "");
+    g_object_set(appsink, "qos", FALSE, nullptr);
+    gst_object_unref(appsink);
+    GstElement* source = pipeline.getElement("source");
+    CHECK_EQ(true, source != nullptr, "");
+    GstPad* source_pad = gst_element_get_static_pad(source, "src");
+    gst_pad_add_probe(source_pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, countQosEvents, &qos_events, nullptr);
+    gst_object_unref(source_pad);
+    gst_object_unref(source);
+
+    pipeline.setQosEnabled(true);
+    pipeline.setFrameCallback(
+        [](const VideoFrameView&) { std::this_thread::sleep_for(std::chrono::milliseconds(30)); });
+    CHECK_EQ(true, pipeline.start(), "");
+    const bool sent = waitFor([&] { return qos_events.load() > 0; }, std::chrono::seconds(5));
+    stopOrExit(pipeline);
+
+    const PipelineStats stats = pipeline.getStats();
+    CHECK_EQ(true, sent, stats.frames_processed << " processed, " << stats.frames_late << " late");
+    CHECK_EQ(true, stats.frames_processed > 0, "");
+}
+
+int main(int argc, char* argv[]) {
+    gst_init(&argc, &argv);
+    if (!haveRequiredElements()) {
+        return kSkipped;
+    }
+    return runTests();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+// Minimal harness: every TEST registers itself, main runs them all and fails
+// when any CHECK did.
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<TestCase>& testCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+inline bool current_failed = false;
+
+struct Register {
+    Register(const char* name, void (*run)()) { testCases().push_back({name, run}); }
+};
+
+#define TEST(suite, name)                                                  \
+    void suite##_##name();                                                 \
+    Register register_##suite##_##name(#suite "." #name, suite##_##name); \
+    void suite##_##name()
+
+// Reports the first mismatch of a test with its context and returns from it.
+#define CHECK_EQ(expected, actual, context)                                        \
+    do {                                                                           \
+        if (!((expected) == (actual))) {                                           \
+            std::ostringstream message;                                            \
+            message << context;                                                    \
+            std::fprintf(stderr, "%s:%d: %s != %s (%s)\n", __FILE__, __LINE__,    \
+                         #expected, #actual, message.str().c_str());               \
+            current_failed = true;                                                 \
+            return;                                                                \
+        }                                                                          \
+    } while (0)
+
+inline int runTests() {
+    int failed = 0;
+    for (const TestCase& test : testCases()) {
+        current_failed = false;
+        test.run();
+        std::printf("%s %s\n", current_failed ? "FAIL" : "ok  ", test.name);
+        failed += current_failed;
+    }
+    std::printf("%d of %zu tests failed\n", failed, testCases().size());
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}